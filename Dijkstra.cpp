@@ -1,65 +1,253 @@
 #include "Dijkstra.h"
 
-#include <queue>
+#include "PriorityQueue.h"
 
-Dijkstra::Dijkstra(const Mesh &mesh, EdgeWeightFunc edge_weight, Mesh::VertexHandle source, Mesh::VertexHandle target)
-    : mesh(mesh), edge_weight(edge_weight), source(source), target(target),
-      distance(std::numeric_limits<double>::infinity(), mesh), previous(Mesh::VertexHandle(), mesh)
+namespace
+{
+// Walks the half-edge structure of the mesh, evaluating the edge weight on the fly
+struct HalfedgeGraph
+{
+    const Mesh &mesh;
+    const Dijkstra::EdgeWeightFunc &edge_weight;
+
+    template <typename Visitor> void for_each_neighbor(int vertex, Visitor &&visit) const
+    {
+        for (const auto &half_edge : mesh.voh_range(Mesh::VertexHandle(vertex)))
+            visit(mesh.to_vertex_handle(half_edge).idx(), edge_weight(half_edge.edge()));
+    }
+};
+
+// Hides the vertices outside a corridor from the search
+template <typename Graph> struct CorridorGraph
+{
+    const Graph &graph;
+    const Dijkstra::Corridor &corridor;
+
+    template <typename Visitor> void for_each_neighbor(int vertex, Visitor &&visit) const
+    {
+        graph.for_each_neighbor(vertex, [&](int neighbor, double weight) {
+            if (corridor.contains(neighbor))
+                visit(neighbor, weight);
+        });
+    }
+};
+
+// Lazy queues are self-contained, indexed ones keep their positions in the workspace
+template <typename PriorityQueue> PriorityQueue make_queue(DijkstraWorkspace::Labels &labels)
+{
+    if constexpr (PriorityQueue::is_indexed)
+        return PriorityQueue(labels.queue_positions());
+    else
+        return PriorityQueue();
+}
+} // namespace
+
+Dijkstra::Dijkstra(const Mesh &mesh, EdgeWeightFunc edge_weight, Mesh::VertexHandle source, Mesh::VertexHandle target,
+                   Options options)
+    : mesh(mesh), edge_weight(edge_weight), source(source), target(target), mode(options.mode), queue(options.queue),
+      landmarks(options.landmarks), corridor(options.corridor),
+      own_workspace(options.workspace ? nullptr : std::make_unique<DijkstraWorkspace>()),
+      workspace(options.workspace ? options.workspace : own_workspace.get())
 {
 }
 
-Dijkstra::Dijkstra(const Mesh &mesh, Mesh::VertexHandle source, Mesh::VertexHandle target)
+Dijkstra::Dijkstra(const Mesh &mesh, Mesh::VertexHandle source, Mesh::VertexHandle target, Options options)
     : Dijkstra(
           mesh,
           [&mesh](Mesh::EdgeHandle e) -> double {
               auto he = mesh.halfedge_handle(e, 0);
               return (mesh.point(mesh.to_vertex_handle(he)) - mesh.point(mesh.from_vertex_handle(he))).norm();
           },
-          source, target)
+          source, target, options)
 {
 }
 
 Dijkstra::Dijkstra(const Mesh &mesh, const OpenMesh::EProp<double> &weights, Mesh::VertexHandle source,
-                   Mesh::VertexHandle target)
-    : Dijkstra(mesh, [&weights](Mesh::EdgeHandle e) -> double { return weights[e]; }, source, target)
+                   Mesh::VertexHandle target, Options options)
+    : Dijkstra(mesh, [&weights](Mesh::EdgeHandle e) -> double { return weights[e]; }, source, target, options)
+{
+}
+
+Dijkstra::Dijkstra(const Mesh &mesh, const MeshGraph &graph, Mesh::VertexHandle source, Mesh::VertexHandle target,
+                   Options options)
+    : mesh(mesh), graph(&graph), source(source), target(target), mode(options.mode), queue(options.queue),
+      landmarks(options.landmarks), corridor(options.corridor),
+      own_workspace(options.workspace ? nullptr : std::make_unique<DijkstraWorkspace>()),
+      workspace(options.workspace ? options.workspace : own_workspace.get())
+{
+}
+
+Dijkstra::Dijkstra(const Mesh &mesh, const MeshGraphF &graph, Mesh::VertexHandle source, Mesh::VertexHandle target,
+                   Options options)
+    : mesh(mesh), graph(&graph), source(source), target(target), mode(options.mode), queue(options.queue),
+      landmarks(options.landmarks), corridor(options.corridor),
+      own_workspace(options.workspace ? nullptr : std::make_unique<DijkstraWorkspace>()),
+      workspace(options.workspace ? options.workspace : own_workspace.get())
 {
 }
 
 void Dijkstra::run()
 {
-    using QueueElem = std::pair<double, Mesh::VertexHandle>;
-    std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<>> queue;
-    std::vector<bool> visited(mesh.n_vertices(), false);
+    num_settled = num_pushes = num_pops = 0;
+
+    bool bidirectional = target.is_valid() && mode == Mode::BIDIRECTIONAL;
+    workspace->begin_query(mesh.n_vertices(), bidirectional);
 
-    distance[source] = 0.0;
-    queue.push({0.0, source});
+    // Goal-directed strategies need a target; a single-source query always grows the full wavefront
+    auto search = [this](auto queue_tag, const auto &graph) {
+        using PriorityQueue = typename decltype(queue_tag)::type;
+        if (!target.is_valid() || mode == Mode::DIJKSTRA)
+            run_unidirectional<PriorityQueue>(graph, [](int) { return 0.0; });
+        else if (mode == Mode::A_STAR && landmarks)
+            run_unidirectional<PriorityQueue>(graph, landmarks->heuristic(target));
+        else if (mode == Mode::A_STAR)
+            run_unidirectional<PriorityQueue>(graph, [this, goal = mesh.point(target)](int v) {
+                return (goal - mesh.point(Mesh::VertexHandle(v))).norm();
+            });
+        else
+            run_bidirectional<PriorityQueue>(graph);
+    };
+
+    auto search_corridor = [&](auto queue_tag, const auto &graph) {
+        if (corridor)
+            search(queue_tag, CorridorGraph<std::decay_t<decltype(graph)>>{graph, *corridor});
+        else
+            search(queue_tag, graph);
+    };
+
+    auto search_graph = [&](auto queue_tag) {
+        if (auto csr = std::get_if<const MeshGraph *>(&graph))
+            search_corridor(queue_tag, **csr);
+        else if (auto csr = std::get_if<const MeshGraphF *>(&graph))
+            search_corridor(queue_tag, **csr);
+        else
+            search_corridor(queue_tag, HalfedgeGraph{mesh, edge_weight});
+    };
+
+    switch (queue)
+    {
+    case Queue::BINARY_HEAP:
+        search_graph(std::type_identity<BinaryHeap>());
+        break;
+    case Queue::RADIX_HEAP:
+        search_graph(std::type_identity<RadixHeap>());
+        break;
+    case Queue::QUATERNARY_HEAP:
+        search_graph(std::type_identity<QuaternaryHeap>());
+        break;
+    }
+}
+
+template <typename PriorityQueue, typename Graph, typename Heuristic>
+void Dijkstra::run_unidirectional(const Graph &graph, const Heuristic &heuristic)
+{
+    // Queue keys are distance + heuristic, the heuristic being zero for plain Dijkstra
+    auto &labels = workspace->forward;
+    auto queue = make_queue<PriorityQueue>(labels);
+
+    labels.set(source.idx(), 0.0, -1);
+    queue.push(heuristic(source.idx()), source.idx());
+    num_pushes++;
 
     while (!queue.empty())
     {
-        auto [dist, current] = queue.top();
-        queue.pop();
+        auto current = queue.pop();
+        num_pops++;
 
-        if (visited[current.idx()])
+        if (labels.is_settled(current))
             continue;
-        visited[current.idx()] = true;
+        labels.settle(current);
+        num_settled++;
+
+        if (current == target.idx())
+            break;
+
+        auto dist = labels.distance(current);
+        graph.for_each_neighbor(current, [&](int neighbor, double weight) {
+            if (labels.is_settled(neighbor))
+                return;
+
+            auto new_dist = dist + weight;
+            if (new_dist < labels.distance(neighbor))
+            {
+                labels.set(neighbor, new_dist, current);
+                queue.push(new_dist + heuristic(neighbor), neighbor);
+                num_pushes++;
+            }
+        });
+    }
+}
+
+template <typename PriorityQueue, typename Graph> void Dijkstra::run_bidirectional(const Graph &graph)
+{
+    // The shortest path is spliced into the forward labels once the wavefronts meet,
+    // the backward labels are scratch space
+    auto &forward = workspace->forward;
+    auto &backward = workspace->backward;
+    auto forward_queue = make_queue<PriorityQueue>(forward);
+    auto backward_queue = make_queue<PriorityQueue>(backward);
 
-        if (current == target)
+    forward.set(source.idx(), 0.0, -1);
+    backward.set(target.idx(), 0.0, -1);
+    forward_queue.push(0.0, source.idx());
+    backward_queue.push(0.0, target.idx());
+    num_pushes += 2;
+
+    // Length of the best path found so far and the vertex where it crosses between the wavefronts
+    double best = source == target ? 0.0 : std::numeric_limits<double>::infinity();
+    int meeting_vertex = source == target ? source.idx() : -1;
+
+    while (!forward_queue.empty() && !backward_queue.empty())
+    {
+        // No path through an unsettled vertex can be shorter than the best one found so far
+        auto forward_radius = forward_queue.top_key();
+        auto backward_radius = backward_queue.top_key();
+        if (forward_radius + backward_radius >= best)
             break;
 
-        for (const auto &half_edge : mesh.voh_range(current))
-        {
-            auto neighbor = mesh.to_vertex_handle(half_edge);
+        // Expand the wavefront with the smaller radius, so that both grow evenly
+        bool is_forward = forward_radius <= backward_radius;
+        auto &queue = is_forward ? forward_queue : backward_queue;
+        auto &labels_this = is_forward ? forward : backward;
+        auto &labels_other = is_forward ? backward : forward;
 
-            if (visited[neighbor.idx()])
-                continue;
+        auto current = queue.pop();
+        num_pops++;
 
-            auto new_dist = dist + edge_weight(half_edge.edge());
-            if (new_dist < distance[neighbor])
+        if (labels_this.is_settled(current))
+            continue;
+        labels_this.settle(current);
+        num_settled++;
+
+        auto dist = labels_this.distance(current);
+        graph.for_each_neighbor(current, [&](int neighbor, double weight) {
+            if (labels_this.is_settled(neighbor))
+                return;
+
+            auto new_dist = dist + weight;
+            if (new_dist < labels_this.distance(neighbor))
             {
-                distance[neighbor] = new_dist;
-                previous[neighbor] = current;
-                queue.push({new_dist, neighbor});
+                labels_this.set(neighbor, new_dist, current);
+                queue.push(new_dist, neighbor);
+                num_pushes++;
             }
-        }
+
+            auto through = labels_this.distance(neighbor) + labels_other.distance(neighbor);
+            if (through < best)
+            {
+                best = through;
+                meeting_vertex = neighbor;
+            }
+        });
+    }
+
+    if (meeting_vertex == -1)
+        return;
+
+    // Splice the backward half of the path into the forward labels, so that get_path(target) works as usual
+    for (auto v = meeting_vertex; v != target.idx(); v = backward.previous(v))
+    {
+        auto w = backward.previous(v);
+        forward.set(w, forward.distance(v) + (backward.distance(v) - backward.distance(w)), v);
     }
 }
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <variant>
 
+#include "DijkstraWorkspace.h"
+#include "Landmarks.h"
 #include "Mesh.h"
+#include "MeshGraph.h"
 #include <OpenMesh/Core/Utils/PropertyManager.hh>
 
 class Dijkstra
@@ -10,16 +16,75 @@ class Dijkstra
   public:
     using EdgeWeightFunc = std::function<double(Mesh::EdgeHandle)>;
 
+    // Search strategy for point-to-point queries (ignored when no target is given)
+    enum class Mode
+    {
+        DIJKSTRA,     // Uniform wavefront from the source
+        A_STAR,       // Goal-directed by the landmark bounds if given, otherwise by the Euclidean distance
+                      // to the target, admissible as long as no edge weight is shorter than the edge itself
+        BIDIRECTIONAL // Two wavefronts, grown from the source and from the target until they meet
+    };
+
+    // Priority queue backend, see PriorityQueue.h
+    enum class Queue
+    {
+        BINARY_HEAP,    // std::priority_queue with lazy deletion
+        RADIX_HEAP,     // Radix heap over the bit patterns of the keys, with lazy deletion
+        QUATERNARY_HEAP // Indexed 4-ary heap with decrease-key
+    };
+
+    // Restricts a search to the vertices carrying the given stamp, e.g. to a corridor around an approximate path.
+    // Vertices outside are never labeled, so the source and the target have to be inside.
+    struct Corridor
+    {
+        const std::vector<std::uint32_t> &stamps;
+        std::uint32_t stamp;
+
+        bool contains(int vertex) const
+        {
+            return stamps[vertex] == stamp;
+        }
+    };
+
+    struct Options
+    {
+        Options(Mode mode = Mode::DIJKSTRA, DijkstraWorkspace *workspace = nullptr, Queue queue = Queue::BINARY_HEAP,
+                const Landmarks *landmarks = nullptr, const Corridor *corridor = nullptr)
+            : mode(mode), workspace(workspace), queue(queue), landmarks(landmarks), corridor(corridor)
+        {
+        }
+
+        Mode mode;
+
+        // Long-lived labels to reuse instead of allocating new ones for this query.
+        // The results of the query stay valid until the next query on the same workspace.
+        DijkstraWorkspace *workspace;
+
+        Queue queue;
+
+        // Lower bounds for A*, built on the same edge weights as the search
+        const Landmarks *landmarks;
+
+        const Corridor *corridor;
+    };
+
     // Default constructor
     Dijkstra(const Mesh &mesh, EdgeWeightFunc edge_weight, Mesh::VertexHandle source,
-             Mesh::VertexHandle target = Mesh::VertexHandle());
+             Mesh::VertexHandle target = Mesh::VertexHandle(), Options options = {});
 
     // Use Euclidean distance as edge weight by default
-    Dijkstra(const Mesh &mesh, Mesh::VertexHandle source, Mesh::VertexHandle target = Mesh::VertexHandle());
+    Dijkstra(const Mesh &mesh, Mesh::VertexHandle source, Mesh::VertexHandle target = Mesh::VertexHandle(),
+             Options options = {});
 
     // Use edge weights from the given property
     Dijkstra(const Mesh &mesh, const OpenMesh::EProp<double> &weights, Mesh::VertexHandle source,
-             Mesh::VertexHandle target = Mesh::VertexHandle());
+             Mesh::VertexHandle target = Mesh::VertexHandle(), Options options = {});
+
+    // Search on a precomputed snapshot of the mesh adjacency (the snapshot must outlive this object)
+    Dijkstra(const Mesh &mesh, const MeshGraph &graph, Mesh::VertexHandle source,
+             Mesh::VertexHandle target = Mesh::VertexHandle(), Options options = {});
+    Dijkstra(const Mesh &mesh, const MeshGraphF &graph, Mesh::VertexHandle source,
+             Mesh::VertexHandle target = Mesh::VertexHandle(), Options options = {});
 
     template <typename... Args> static Dijkstra compute(Args &&...args)
     {
@@ -33,12 +98,12 @@ class Dijkstra
 
     bool has_path(Mesh::VertexHandle vertex) const
     {
-        return distance[vertex] != std::numeric_limits<double>::infinity();
+        return get_distance(vertex) != std::numeric_limits<double>::infinity();
     }
 
     double get_distance(Mesh::VertexHandle vertex) const
     {
-        return distance[vertex];
+        return workspace->forward.distance(vertex.idx());
     }
 
     std::vector<Mesh::VertexHandle> get_path(Mesh::VertexHandle vertex) const
@@ -47,7 +112,7 @@ class Dijkstra
             return {};
 
         std::vector<Mesh::VertexHandle> path;
-        for (auto v = vertex; v.is_valid(); v = previous[v])
+        for (auto v = vertex; v.is_valid(); v = get_previous(v))
             path.push_back(v);
         std::reverse(path.begin(), path.end());
         return path;
@@ -55,16 +120,46 @@ class Dijkstra
 
     Mesh::VertexHandle get_previous(Mesh::VertexHandle vertex) const
     {
-        return previous[vertex];
+        return Mesh::VertexHandle(workspace->forward.previous(vertex.idx()));
+    }
+
+    // Number of vertices settled by the last run (both wavefronts in bidirectional mode)
+    size_t get_num_settled() const
+    {
+        return num_settled;
+    }
+
+    // Number of queue insertions (including key decreases) and removals of the last run
+    size_t get_num_pushes() const
+    {
+        return num_pushes;
+    }
+
+    size_t get_num_pops() const
+    {
+        return num_pops;
     }
 
   private:
     const Mesh &mesh;
     const EdgeWeightFunc edge_weight;
+    const std::variant<std::monostate, const MeshGraph *, const MeshGraphF *> graph;
 
     Mesh::VertexHandle source;
     Mesh::VertexHandle target;
-
-    OpenMesh::VProp<double> distance;
-    OpenMesh::VProp<Mesh::VertexHandle> previous;
-};
\ No newline at end of file
+    Mode mode;
+    Queue queue;
+    const Landmarks *landmarks;
+    const Corridor *corridor;
+
+    std::unique_ptr<DijkstraWorkspace> own_workspace; // only allocated when no workspace is given
+    DijkstraWorkspace *workspace;
+
+    size_t num_settled = 0;
+    size_t num_pushes = 0;
+    size_t num_pops = 0;
+
+    template <typename PriorityQueue, typename Graph, typename Heuristic>
+    void run_unidirectional(const Graph &graph, const Heuristic &heuristic);
+    template <typename PriorityQueue, typename Graph> void run_bidirectional(const Graph &graph);
+};
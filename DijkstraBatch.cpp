@@ -0,0 +1,130 @@
+#include "DijkstraBatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "ShortestPathTree.h"
+
+namespace
+{
+// Paths are collected per thread while the queries run and gathered into the flat buffer in query order
+struct PathSlice
+{
+    unsigned thread = 0;
+    size_t begin = 0;
+    size_t size = 0;
+};
+
+void gather_paths(const std::vector<std::vector<Mesh::VertexHandle>> &thread_vertices,
+                  const std::vector<PathSlice> &slices, std::vector<size_t> &offsets,
+                  std::vector<Mesh::VertexHandle> &vertices)
+{
+    offsets.assign(slices.size() + 1, 0);
+    for (size_t query = 0; query < slices.size(); ++query)
+        offsets[query + 1] = offsets[query] + slices[query].size;
+
+    vertices.resize(offsets.back());
+    for (size_t query = 0; query < slices.size(); ++query)
+    {
+        const auto &slice = slices[query];
+        auto first = thread_vertices[slice.thread].begin() + slice.begin;
+        std::copy(first, first + slice.size, vertices.begin() + offsets[query]);
+    }
+}
+} // namespace
+
+DijkstraBatch::DijkstraBatch(const Mesh &mesh, const MeshGraph &graph, Dijkstra::Options options,
+                             unsigned num_threads)
+    : mesh(mesh), graph(graph), options(options),
+      num_threads(num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    this->options.workspace = nullptr;
+}
+
+template <typename Task> void DijkstraBatch::for_each_task(size_t num_tasks, const Task &task) const
+{
+    // The queries are independent and of very different cost, so threads pull them one at a time
+    std::atomic<size_t> next_task = 0;
+    auto worker = [&](unsigned thread_index) {
+        for (auto i = next_task.fetch_add(1, std::memory_order_relaxed); i < num_tasks;
+             i = next_task.fetch_add(1, std::memory_order_relaxed))
+            task(thread_index, i);
+    };
+
+    auto num_workers = static_cast<unsigned>(std::min<size_t>(num_threads, num_tasks));
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_workers; ++t)
+        threads.emplace_back(worker, t);
+    worker(0);
+    for (auto &thread : threads)
+        thread.join();
+}
+
+DijkstraBatch::Result DijkstraBatch::run(
+    const std::vector<std::pair<Mesh::VertexHandle, Mesh::VertexHandle>> &pairs) const
+{
+    Result result;
+    result.distances.assign(pairs.size(), std::numeric_limits<double>::infinity());
+
+    std::vector<DijkstraWorkspace> workspaces(num_threads);
+    std::vector<std::vector<Mesh::VertexHandle>> thread_vertices(num_threads);
+    std::vector<PathSlice> slices(pairs.size());
+
+    for_each_task(pairs.size(), [&](unsigned thread_index, size_t query) {
+        auto [source, target] = pairs[query];
+        auto query_options = options;
+        query_options.workspace = &workspaces[thread_index];
+        auto dijkstra = Dijkstra::compute(mesh, graph, source, target, query_options);
+        if (!dijkstra.has_path(target))
+            return;
+
+        result.distances[query] = dijkstra.get_distance(target);
+
+        // The path is walked backwards from the target and reversed in place
+        auto &buffer = thread_vertices[thread_index];
+        auto begin = buffer.size();
+        for (auto v = target; v.is_valid(); v = dijkstra.get_previous(v))
+            buffer.push_back(v);
+        std::reverse(buffer.begin() + begin, buffer.end());
+        slices[query] = {thread_index, begin, buffer.size() - begin};
+    });
+
+    gather_paths(thread_vertices, slices, result.offsets, result.vertices);
+    return result;
+}
+
+DijkstraBatch::Result DijkstraBatch::run(const std::vector<Mesh::VertexHandle> &sources,
+                                         const std::vector<Mesh::VertexHandle> &targets) const
+{
+    Result result;
+    result.distances.assign(sources.size() * targets.size(), std::numeric_limits<double>::infinity());
+
+    std::vector<std::unique_ptr<ShortestPathTree>> trees(num_threads);
+    std::vector<std::vector<Mesh::VertexHandle>> thread_vertices(num_threads);
+    std::vector<PathSlice> slices(result.distances.size());
+
+    for_each_task(sources.size(), [&](unsigned thread_index, size_t i) {
+        auto &tree = trees[thread_index];
+        if (!tree)
+            tree = std::make_unique<ShortestPathTree>(graph);
+        tree->reset(sources[i]);
+
+        auto &buffer = thread_vertices[thread_index];
+        for (size_t j = 0; j < targets.size(); ++j)
+        {
+            auto query = i * targets.size() + j;
+            if (!tree->has_path(targets[j]))
+                continue;
+
+            result.distances[query] = tree->get_distance(targets[j]);
+            auto path = tree->get_path(targets[j]);
+            slices[query] = {thread_index, buffer.size(), path.size()};
+            buffer.insert(buffer.end(), path.begin(), path.end());
+        }
+    });
+
+    gather_paths(thread_vertices, slices, result.offsets, result.vertices);
+    return result;
+}
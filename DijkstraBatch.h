@@ -0,0 +1,70 @@
+#pragma once
+
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "Dijkstra.h"
+#include "Mesh.h"
+#include "MeshGraph.h"
+
+// Many shortest path queries on one graph, run concurrently. Every worker thread has its own workspace and
+// the mesh and graph are only read, so a batch can be run on a const Mesh from several threads at once.
+class DijkstraBatch
+{
+  public:
+    // Distances and paths of all queries of a batch, in query order. The paths share one flat buffer.
+    class Result
+    {
+      public:
+        size_t size() const
+        {
+            return distances.size();
+        }
+
+        bool has_path(size_t query) const
+        {
+            return distances[query] != std::numeric_limits<double>::infinity();
+        }
+
+        double get_distance(size_t query) const
+        {
+            return distances[query];
+        }
+
+        // Empty if there is no path
+        std::span<const Mesh::VertexHandle> get_path(size_t query) const
+        {
+            return std::span<const Mesh::VertexHandle>(vertices).subspan(offsets[query],
+                                                                         offsets[query + 1] - offsets[query]);
+        }
+
+      private:
+        friend class DijkstraBatch;
+
+        std::vector<double> distances;
+        std::vector<size_t> offsets; // start of each path in the buffer, plus one past the last path
+        std::vector<Mesh::VertexHandle> vertices;
+    };
+
+    // The mesh, the graph and the landmarks of the options must outlive the batch; the workspace of the
+    // options is ignored. num_threads = 0 uses all hardware threads
+    DijkstraBatch(const Mesh &mesh, const MeshGraph &graph, Dijkstra::Options options = {}, unsigned num_threads = 0);
+
+    // One point-to-point search per pair, with the mode of the options
+    Result run(const std::vector<std::pair<Mesh::VertexHandle, Mesh::VertexHandle>> &pairs) const;
+
+    // All sources to all targets, the query of sources[i] and targets[j] being i * targets.size() + j.
+    // Every source grows one shortest path tree until all targets are settled.
+    Result run(const std::vector<Mesh::VertexHandle> &sources, const std::vector<Mesh::VertexHandle> &targets) const;
+
+  private:
+    const Mesh &mesh;
+    const MeshGraph &graph;
+    Dijkstra::Options options;
+    unsigned num_threads;
+
+    // Runs task(thread_index, task_index) for every task, on threads that take the next task as soon as they
+    // are done with the previous one
+    template <typename Task> void for_each_task(size_t num_tasks, const Task &task) const;
+};
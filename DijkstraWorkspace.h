@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Per-vertex labels of shortest path queries, meant to be kept alive across queries.
+// Every label is stamped with the query that wrote it, so starting a new query is O(1)
+// and a query only ever touches the vertices it explores.
+class DijkstraWorkspace
+{
+  public:
+    class Labels
+    {
+      public:
+        double distance(int vertex) const
+        {
+            return is_current(vertex) ? labels[vertex].distance : std::numeric_limits<double>::infinity();
+        }
+
+        int previous(int vertex) const
+        {
+            return is_current(vertex) ? labels[vertex].previous : -1;
+        }
+
+        bool is_settled(int vertex) const
+        {
+            return labels[vertex].stamp == epoch + 1;
+        }
+
+        // Settled vertices keep their settled state
+        void set(int vertex, double distance, int previous)
+        {
+            auto &label = labels[vertex];
+            label.distance = distance;
+            label.previous = previous;
+            if (label.stamp < epoch)
+                label.stamp = epoch;
+        }
+
+        void settle(int vertex)
+        {
+            labels[vertex].stamp = epoch + 1;
+        }
+
+        size_t size() const
+        {
+            return labels.size();
+        }
+
+        // Scratch space for indexed priority queues, -1 for every vertex not in a queue
+        std::vector<std::int32_t> &queue_positions()
+        {
+            if (positions.size() != labels.size())
+                positions.assign(labels.size(), -1);
+            return positions;
+        }
+
+        // Invalidates all labels; resizing is the only O(n) operation
+        void reset(size_t n_vertices)
+        {
+            if (labels.size() != n_vertices || epoch >= std::numeric_limits<std::uint32_t>::max() - 2)
+            {
+                labels.assign(n_vertices, {std::numeric_limits<double>::infinity(), -1, 0});
+                epoch = 2;
+            }
+            else
+                epoch += 2;
+        }
+
+      private:
+        struct Label
+        {
+            double distance;
+            std::int32_t previous;
+            std::uint32_t stamp; // epoch: labeled by the current query, epoch + 1: also settled
+        };
+
+        std::vector<Label> labels;
+        std::vector<std::int32_t> positions;
+        std::uint32_t epoch = 0;
+
+        bool is_current(int vertex) const
+        {
+            return labels[vertex].stamp >= epoch;
+        }
+    };
+
+    // Starts a new query, the backward labels are only needed by bidirectional searches
+    void begin_query(size_t n_vertices, bool bidirectional = false)
+    {
+        forward.reset(n_vertices);
+        if (bidirectional)
+            backward.reset(n_vertices);
+    }
+
+    Labels forward;
+    Labels backward;
+};
@@ -0,0 +1,232 @@
+#include "DistanceField.h"
+
+#include <atomic>
+#include <barrier>
+#include <bit>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+// Distance and label packed into one word, so that both are updated by a single atomic min.
+// Non-negative floats compare like their bit patterns, hence the packed keys order by distance first
+// and by label second.
+using Key = std::uint64_t;
+
+constexpr Key UNREACHED = std::numeric_limits<Key>::max();
+
+Key pack(float distance, std::uint32_t label)
+{
+    return (Key(std::bit_cast<std::uint32_t>(distance)) << 32) | label;
+}
+
+float unpack_distance(Key key)
+{
+    return std::bit_cast<float>(static_cast<std::uint32_t>(key >> 32));
+}
+
+std::uint32_t unpack_label(Key key)
+{
+    return static_cast<std::uint32_t>(key);
+}
+
+// Lowers the key atomically, returns whether it was lowered
+bool atomic_min(std::atomic<Key> &target, Key key)
+{
+    auto current = target.load(std::memory_order_relaxed);
+    while (key < current)
+        if (target.compare_exchange_weak(current, key, std::memory_order_relaxed))
+            return true;
+    return false;
+}
+} // namespace
+
+template <typename Weight>
+DistanceField::DistanceField(const MeshGraphT<Weight> &graph, const std::vector<Mesh::VertexHandle> &sources,
+                             unsigned num_threads)
+    : sources(sources)
+{
+    const size_t n = graph.n_vertices();
+    distances.assign(n, std::numeric_limits<float>::infinity());
+    labels.assign(n, -1);
+    if (sources.empty() || n == 0)
+        return;
+
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Bucket width of the order of an edge, so that a bucket is a thin band of the wavefront
+    double total_weight = 0.0;
+    for (size_t v = 0; v < n; ++v)
+        graph.for_each_neighbor(static_cast<int>(v), [&](int, double weight) { total_weight += weight; });
+    const float delta = graph.n_arcs() > 0 && total_weight > 0.0 ? float(total_weight / graph.n_arcs()) : 1.0f;
+
+    std::vector<std::atomic<Key>> keys(n);
+    for (auto &key : keys)
+        key.store(UNREACHED, std::memory_order_relaxed);
+
+    // Vertices are bucketed by floor(distance / delta); entries whose key has since dropped to an earlier
+    // bucket are stale and skipped
+    std::vector<std::vector<int>> buckets(1);
+    auto bucket_of = [&](Key key) { return static_cast<size_t>(unpack_distance(key) / delta); };
+
+    for (size_t i = 0; i < sources.size(); ++i)
+        if (atomic_min(keys[sources[i].idx()], pack(0.0f, static_cast<std::uint32_t>(i))))
+            buckets[0].push_back(sources[i].idx());
+
+    // Every round relaxes all edges of the current frontier in parallel; vertices whose key dropped are
+    // collected per thread and bucketed between rounds
+    std::vector<int> frontier;
+    std::vector<std::vector<int>> updated(num_threads);
+    std::vector<std::uint32_t> in_frontier(n, 0);
+    std::uint32_t round = 0;
+    size_t current_bucket = 0;
+    bool done = false;
+
+    // An exception escaping a worker or the barrier completion would call std::terminate, so the first one is
+    // kept, ends the rounds and is rethrown once the threads have joined
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto keep_error = [&]() {
+        std::lock_guard lock(error_mutex);
+        if (!error)
+            error = std::current_exception();
+    };
+
+    auto advance = [&]() {
+        for (auto &thread_updated : updated)
+        {
+            for (int v : thread_updated)
+            {
+                auto bucket = bucket_of(keys[v].load(std::memory_order_relaxed));
+                if (bucket >= buckets.size())
+                    buckets.resize(bucket + 1);
+                buckets[bucket].push_back(v);
+            }
+            thread_updated.clear();
+        }
+
+        while (current_bucket < buckets.size() && buckets[current_bucket].empty())
+            current_bucket++;
+        if (current_bucket == buckets.size())
+        {
+            done = true;
+            return;
+        }
+
+        round++;
+        frontier.clear();
+        for (int v : buckets[current_bucket])
+            if (in_frontier[v] != round && bucket_of(keys[v].load(std::memory_order_relaxed)) == current_bucket)
+            {
+                in_frontier[v] = round;
+                frontier.push_back(v);
+            }
+        buckets[current_bucket].clear();
+    };
+
+    // Runs as the barrier completion, which must not throw
+    auto next_round = [&]() noexcept {
+        try
+        {
+            if (!error)
+                advance();
+        }
+        catch (...)
+        {
+            keep_error();
+        }
+        if (error)
+            done = true;
+    };
+
+    auto relax = [&](unsigned thread_index) {
+        const size_t chunk = (frontier.size() + num_threads - 1) / num_threads;
+        const size_t begin = std::min(frontier.size(), thread_index * chunk);
+        const size_t end = std::min(frontier.size(), begin + chunk);
+        try
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                int v = frontier[i];
+                auto key = keys[v].load(std::memory_order_relaxed);
+                auto distance = unpack_distance(key);
+                auto label = unpack_label(key);
+                graph.for_each_neighbor(v, [&](int neighbor, double weight) {
+                    if (atomic_min(keys[neighbor], pack(distance + static_cast<float>(weight), label)))
+                        updated[thread_index].push_back(neighbor);
+                });
+            }
+        }
+        catch (...)
+        {
+            // Still arrives at the barrier, so that the other threads are not left waiting
+            keep_error();
+        }
+    };
+
+    next_round();
+    if (num_threads == 1)
+    {
+        while (!done)
+        {
+            relax(0);
+            next_round();
+        }
+    }
+    else
+    {
+        std::barrier sync(num_threads, next_round);
+        auto worker = [&](unsigned thread_index) {
+            while (!done)
+            {
+                relax(thread_index);
+                sync.arrive_and_wait();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < num_threads; ++t)
+        {
+            try
+            {
+                threads.emplace_back(worker, t);
+            }
+            catch (...)
+            {
+                // The threads that could not be started leave the barrier, the error ends the first round
+                keep_error();
+                for (; t < num_threads; ++t)
+                    sync.arrive_and_drop();
+            }
+        }
+        worker(0);
+        for (auto &thread : threads)
+            thread.join();
+    }
+    if (error)
+        std::rethrow_exception(error);
+
+    for (size_t v = 0; v < n; ++v)
+    {
+        auto key = keys[v].load(std::memory_order_relaxed);
+        if (key == UNREACHED)
+            continue;
+        distances[v] = unpack_distance(key);
+        labels[v] = static_cast<int>(unpack_label(key));
+    }
+}
+
+template DistanceField::DistanceField(const MeshGraph &, const std::vector<Mesh::VertexHandle> &, unsigned);
+template DistanceField::DistanceField(const MeshGraphF &, const std::vector<Mesh::VertexHandle> &, unsigned);
+
+std::vector<Mesh::VertexHandle> DistanceField::boundary_vertices(const Mesh &mesh)
+{
+    std::vector<Mesh::VertexHandle> boundary;
+    for (const auto &v : mesh.vertices())
+        if (mesh.is_boundary(v))
+            boundary.push_back(v);
+    return boundary;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshGraph.h"
+
+// Graph distance from a set of source vertices to every vertex of the mesh, along with the nearest source.
+// All sources are seeded at distance 0. The field is computed by parallel delta-stepping in single precision;
+// ties between equally distant sources go to the source listed first, so the result does not depend on the
+// number of threads.
+class DistanceField
+{
+  public:
+    // num_threads = 0 uses all hardware threads
+    template <typename Weight>
+    DistanceField(const MeshGraphT<Weight> &graph, const std::vector<Mesh::VertexHandle> &sources,
+                  unsigned num_threads = 0);
+
+    // All boundary vertices of the mesh, e.g. for a distance-from-boundary field
+    static std::vector<Mesh::VertexHandle> boundary_vertices(const Mesh &mesh);
+
+    bool has_path(Mesh::VertexHandle vertex) const
+    {
+        return labels[vertex.idx()] != -1;
+    }
+
+    double get_distance(Mesh::VertexHandle vertex) const
+    {
+        return distances[vertex.idx()];
+    }
+
+    // Index into the source list of the nearest source, or -1 if no source can be reached
+    int get_label(Mesh::VertexHandle vertex) const
+    {
+        return labels[vertex.idx()];
+    }
+
+    Mesh::VertexHandle get_nearest_source(Mesh::VertexHandle vertex) const
+    {
+        return has_path(vertex) ? sources[labels[vertex.idx()]] : Mesh::VertexHandle();
+    }
+
+    const std::vector<float> &get_distances() const
+    {
+        return distances;
+    }
+
+    const std::vector<int> &get_labels() const
+    {
+        return labels;
+    }
+
+  private:
+    std::vector<Mesh::VertexHandle> sources;
+    std::vector<float> distances;
+    std::vector<int> labels;
+};
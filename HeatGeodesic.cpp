@@ -0,0 +1,205 @@
+#include "HeatGeodesic.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+HeatGeodesic::HeatGeodesic(const Mesh &mesh, double time_factor)
+{
+    const int n = static_cast<int>(mesh.n_vertices());
+
+    // Per-face geometry, cotan Laplacian L (positive semi-definite) and lumped mass matrix A
+    std::vector<Eigen::Triplet<double>> laplacian_entries;
+    laplacian_entries.reserve(mesh.n_faces() * 12);
+    Eigen::VectorXd mass = Eigen::VectorXd::Zero(n);
+
+    faces.reserve(mesh.n_faces());
+    for (const auto &f : mesh.faces())
+    {
+        Face face;
+        int k = 0;
+        for (const auto &v : mesh.fv_range(f))
+            face.vertices[k++] = v.idx();
+
+        std::array<Eigen::Vector3d, 3> p;
+        for (int i = 0; i < 3; ++i)
+            p[i] = mesh.point(Mesh::VertexHandle(face.vertices[i]));
+        std::array<Eigen::Vector3d, 3> edges; // opposite each corner, counter-clockwise
+        for (int i = 0; i < 3; ++i)
+            edges[i] = p[(i + 2) % 3] - p[(i + 1) % 3];
+
+        Eigen::Vector3d normal = edges[0].cross(edges[1]);
+        double double_area = normal.norm();
+        if (double_area <= std::numeric_limits<double>::min())
+            continue; // degenerate faces carry no area and no gradient
+        normal /= double_area;
+        face.area = double_area / 2.0;
+
+        std::array<double, 3> cotangents; // of the angle at each corner
+        for (int i = 0; i < 3; ++i)
+        {
+            const auto &a = edges[(i + 2) % 3]; // from corner i to the next corner
+            const auto &b = edges[(i + 1) % 3]; // from the previous corner to corner i
+            cotangents[i] = -a.dot(b) / a.cross(b).norm();
+            face.gradients[i] = normal.cross(edges[i]) / double_area;
+            mass[face.vertices[i]] += double_area / 6.0;
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            int a = face.vertices[(i + 1) % 3], b = face.vertices[(i + 2) % 3];
+            double w = 0.5 * cotangents[i];
+            laplacian_entries.emplace_back(a, b, -w);
+            laplacian_entries.emplace_back(b, a, -w);
+            laplacian_entries.emplace_back(a, a, w);
+            laplacian_entries.emplace_back(b, b, w);
+        }
+
+        faces.push_back(face);
+    }
+
+    Eigen::SparseMatrix<double> laplacian(n, n);
+    laplacian.setFromTriplets(laplacian_entries.begin(), laplacian_entries.end());
+
+    // Isolated vertices would make both systems singular
+    for (int i = 0; i < n; ++i)
+        if (mass[i] == 0.0)
+            mass[i] = 1.0;
+
+    double edge_length = 0.0;
+    for (const auto &e : mesh.edges())
+    {
+        auto he = mesh.halfedge_handle(e, 0);
+        edge_length += (mesh.point(mesh.to_vertex_handle(he)) - mesh.point(mesh.from_vertex_handle(he))).norm();
+    }
+    edge_length /= std::max<size_t>(1, mesh.n_edges());
+    double time = time_factor * edge_length * edge_length;
+
+    Eigen::SparseMatrix<double> mass_matrix(n, n);
+    std::vector<Eigen::Triplet<double>> mass_entries;
+    mass_entries.reserve(n);
+    for (int i = 0; i < n; ++i)
+        mass_entries.emplace_back(i, i, mass[i]);
+    mass_matrix.setFromTriplets(mass_entries.begin(), mass_entries.end());
+
+    heat_solver.compute(mass_matrix + time * laplacian);
+    if (heat_solver.info() != Eigen::Success)
+        throw std::runtime_error("Heat geodesic setup failed: could not factor the heat operator");
+
+    // L is singular (constants per connected component), a tiny mass term makes it definite
+    poisson_solver.compute(laplacian + 1e-8 * mass_matrix);
+    if (poisson_solver.info() != Eigen::Success)
+        throw std::runtime_error("Heat geodesic setup failed: could not factor the Laplacian");
+
+    // Adjacency and connected components, for path tracing and reachability
+    neighbors.resize(n);
+    for (const auto &v : mesh.vertices())
+        for (const auto &w : mesh.vv_range(v))
+            neighbors[v.idx()].push_back(w.idx());
+
+    components.assign(n, -1);
+    std::vector<int> stack;
+    for (int seed = 0, component = 0; seed < n; ++seed)
+    {
+        if (components[seed] != -1)
+            continue;
+        components[seed] = component;
+        stack.push_back(seed);
+        while (!stack.empty())
+        {
+            int v = stack.back();
+            stack.pop_back();
+            for (int w : neighbors[v])
+                if (components[w] == -1)
+                {
+                    components[w] = component;
+                    stack.push_back(w);
+                }
+        }
+        component++;
+    }
+
+    rhs = Eigen::VectorXd::Zero(n);
+    heat = Eigen::VectorXd::Zero(n);
+    distance = Eigen::VectorXd::Zero(n);
+    reached.assign(n, false);
+}
+
+void HeatGeodesic::compute(Mesh::VertexHandle source)
+{
+    compute(std::vector<Mesh::VertexHandle>{source});
+}
+
+void HeatGeodesic::compute(const std::vector<Mesh::VertexHandle> &sources)
+{
+    const int n = static_cast<int>(neighbors.size());
+
+    this->sources.clear();
+    std::vector<bool> source_component(n, false);
+    for (const auto &s : sources)
+    {
+        this->sources.push_back(s.idx());
+        source_component[components[s.idx()]] = true;
+    }
+
+    // 1. Diffuse heat from the sources for a short time
+    rhs.setZero();
+    for (int s : this->sources)
+        rhs[s] = 1.0;
+    heat = heat_solver.solve(rhs);
+
+    // 2. Normalize the negated heat gradient X and take its divergence, which the cotan formula integrates over
+    //    each face as -area * dot(gradient of the hat function, X) per corner. The Poisson system takes it negated
+    rhs.setZero();
+    for (const auto &face : faces)
+    {
+        Eigen::Vector3d gradient = heat[face.vertices[0]] * face.gradients[0] +
+                                   heat[face.vertices[1]] * face.gradients[1] +
+                                   heat[face.vertices[2]] * face.gradients[2];
+
+        double norm = gradient.norm();
+        if (norm <= std::numeric_limits<double>::min())
+            continue;
+        double scale = face.area / norm;
+
+        for (int i = 0; i < 3; ++i)
+            rhs[face.vertices[i]] -= scale * face.gradients[i].dot(gradient);
+    }
+
+    // 3. Recover the distance whose gradient best matches the normalized field, shifted to start at zero
+    distance = poisson_solver.solve(rhs);
+
+    double offset = std::numeric_limits<double>::infinity();
+    for (int v = 0; v < n; ++v)
+    {
+        reached[v] = source_component[components[v]];
+        if (reached[v])
+            offset = std::min(offset, distance[v]);
+    }
+    for (int v = 0; v < n; ++v)
+        distance[v] = reached[v] ? std::max(0.0, distance[v] - offset) : 0.0;
+    for (int s : this->sources)
+        distance[s] = 0.0;
+}
+
+std::vector<Mesh::VertexHandle> HeatGeodesic::get_path(Mesh::VertexHandle vertex) const
+{
+    if (!has_path(vertex))
+        return {};
+
+    std::vector<Mesh::VertexHandle> path{vertex};
+    for (int v = vertex.idx(); std::find(sources.begin(), sources.end(), v) == sources.end();)
+    {
+        int next = v;
+        for (int w : neighbors[v])
+            if (distance[w] < distance[next])
+                next = w;
+
+        if (next == v)
+            return {}; // stuck in a local minimum
+
+        v = next;
+        path.push_back(Mesh::VertexHandle(v));
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
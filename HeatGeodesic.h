@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+
+#include "Mesh.h"
+
+// Geodesic distance by the heat method (Crane et al., "Geodesics in Heat").
+// The cotan Laplacian and the mass matrix are assembled and factored once per mesh on construction,
+// after which every query costs two back-substitutions plus a linear pass over the faces.
+// The mesh is not referenced after construction, later changes to it are not picked up.
+class HeatGeodesic
+{
+  public:
+    // The diffusion time is time_factor * (mean edge length)^2
+    explicit HeatGeodesic(const Mesh &mesh, double time_factor = 1.0);
+
+    // Distance from the given source(s) to every vertex, replacing the result of the previous query
+    void compute(Mesh::VertexHandle source);
+    void compute(const std::vector<Mesh::VertexHandle> &sources);
+
+    // Vertices in other connected components than the sources are not reached
+    bool has_path(Mesh::VertexHandle vertex) const
+    {
+        return reached[vertex.idx()];
+    }
+
+    double get_distance(Mesh::VertexHandle vertex) const
+    {
+        return has_path(vertex) ? distance[vertex.idx()] : std::numeric_limits<double>::infinity();
+    }
+
+    // Path from a source to the given vertex, following the steepest descent of the distance along the edges.
+    // Same layout as Dijkstra::get_path; empty if the vertex is not reached or the descent gets stuck
+    // in a spurious local minimum.
+    std::vector<Mesh::VertexHandle> get_path(Mesh::VertexHandle vertex) const;
+
+  private:
+    // Only what the divergence pass reads, which streams through all faces on every query
+    struct Face
+    {
+        std::array<int, 3> vertices;
+        double area;
+        std::array<Eigen::Vector3d, 3> gradients; // gradient of the hat function of each corner
+    };
+
+    std::vector<Face> faces;
+    std::vector<std::vector<int>> neighbors;
+    std::vector<int> components; // connected component of each vertex
+
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> heat_solver;    // A + t L
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> poisson_solver; // L, regularized
+
+    std::vector<int> sources;
+    Eigen::VectorXd rhs;  // of both solves, kept between queries like the heat
+    Eigen::VectorXd heat;
+    Eigen::VectorXd distance;
+    std::vector<bool> reached;
+};
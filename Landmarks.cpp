@@ -0,0 +1,61 @@
+#include "Landmarks.h"
+
+#include <algorithm>
+
+#include "DistanceField.h"
+
+template <typename Weight>
+Landmarks::Landmarks(const MeshGraphT<Weight> &graph, unsigned num_landmarks, unsigned num_threads)
+{
+    const size_t n = graph.n_vertices();
+
+    // Isolated vertices would only attract landmarks without bounding anything
+    auto is_isolated = [&](size_t v) {
+        auto index = static_cast<typename MeshGraphT<Weight>::Index>(v);
+        return graph.arcs_begin(index) == graph.arcs_end(index);
+    };
+
+    // The vertex farthest from all landmarks so far; unreached vertices come first, so that every
+    // connected component gets a landmark before any component gets a second one
+    std::vector<float> nearest(n, std::numeric_limits<float>::infinity());
+    auto farthest = [&]() {
+        Mesh::VertexHandle best;
+        for (size_t v = 0; v < n; ++v)
+            if (!is_isolated(v) && (!best.is_valid() || nearest[v] > nearest[best.idx()]))
+                best = Mesh::VertexHandle(static_cast<int>(v));
+        return best;
+    };
+
+    // Start from the vertex farthest from an arbitrary one, which lies on the periphery of the mesh
+    auto seed = farthest();
+    if (!seed.is_valid())
+        return;
+    nearest = DistanceField(graph, {seed}, num_threads).get_distances();
+
+    std::vector<std::vector<float>> fields;
+    while (fields.size() < num_landmarks)
+    {
+        auto landmark = farthest();
+        if (nearest[landmark.idx()] == 0.0f)
+            break; // every vertex is a landmark already
+
+        // The seed only served to find the first landmark
+        DistanceField field(graph, {landmark}, num_threads);
+        if (landmarks.empty())
+            nearest = field.get_distances();
+        else
+            for (size_t v = 0; v < n; ++v)
+                nearest[v] = std::min(nearest[v], field.get_distances()[v]);
+
+        landmarks.push_back(landmark);
+        fields.push_back(field.get_distances());
+    }
+
+    distances.resize(n * landmarks.size());
+    for (size_t i = 0; i < landmarks.size(); ++i)
+        for (size_t v = 0; v < n; ++v)
+            distances[v * landmarks.size() + i] = fields[i][v];
+}
+
+template Landmarks::Landmarks(const MeshGraph &, unsigned, unsigned);
+template Landmarks::Landmarks(const MeshGraphF &, unsigned, unsigned);
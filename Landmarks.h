@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshGraph.h"
+
+// Landmark index for A* with ALT lower bounds (A*, landmarks, triangle inequality).
+// The graph distances from a few landmarks spread over the mesh bound the distance between any two vertices
+// from below: d(v, t) >= |d(L, t) - d(L, v)| for every landmark L. The bounds are only valid for searches
+// with the same edge weights as the graph the index was built on.
+class Landmarks
+{
+  public:
+    // Landmarks are chosen by farthest-point sampling on the graph, each distance field is computed in parallel.
+    // num_threads = 0 uses all hardware threads
+    template <typename Weight>
+    Landmarks(const MeshGraphT<Weight> &graph, unsigned num_landmarks = 16, unsigned num_threads = 0);
+
+    // Lower bound of the distance to a fixed target, evaluated by the search for every queued vertex
+    class Heuristic
+    {
+      public:
+        double operator()(int vertex) const
+        {
+            // Both rows are laid out landmark by landmark, unreachable landmarks give no bound
+            const float *row = distances + size_t(vertex) * num_landmarks;
+            float bound = 0.0f;
+            for (size_t i = 0; i < num_landmarks; ++i)
+            {
+                float difference = std::abs(target_row[i] - row[i]);
+                if (difference > bound && difference != std::numeric_limits<float>::infinity())
+                    bound = difference;
+            }
+            return bound * SHRINK;
+        }
+
+      private:
+        friend class Landmarks;
+
+        Heuristic(const float *distances, size_t num_landmarks, Mesh::VertexHandle target)
+            : distances(distances), num_landmarks(num_landmarks),
+              target_row(distances + size_t(target.idx()) * num_landmarks)
+        {
+        }
+
+        // The distances are accumulated in single precision, the bound is scaled down slightly so that
+        // rounding cannot make it overestimate
+        static constexpr float SHRINK = 1.0f - 1e-4f;
+
+        const float *distances;
+        size_t num_landmarks;
+        const float *target_row;
+    };
+
+    Heuristic heuristic(Mesh::VertexHandle target) const
+    {
+        return Heuristic(distances.data(), landmarks.size(), target);
+    }
+
+    double lower_bound(Mesh::VertexHandle from, Mesh::VertexHandle to) const
+    {
+        return heuristic(to)(from.idx());
+    }
+
+    size_t n_vertices() const
+    {
+        return landmarks.empty() ? 0 : distances.size() / landmarks.size();
+    }
+
+    const std::vector<Mesh::VertexHandle> &get_landmarks() const
+    {
+        return landmarks;
+    }
+
+    // Size of the distance table in bytes
+    size_t memory_footprint() const
+    {
+        return distances.size() * sizeof(float);
+    }
+
+  private:
+    std::vector<Mesh::VertexHandle> landmarks;
+    std::vector<float> distances; // vertex-major, the distances of one vertex to all landmarks are contiguous
+};
@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &filename)
+{
+#ifdef _WIN32
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = nullptr;
+        return;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+        return;
+    length = static_cast<size_t>(file_size.QuadPart);
+    if (length == 0)
+    {
+        is_mapped = true;
+        return;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+        return;
+    address = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    is_mapped = address != nullptr;
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        return;
+    struct stat status;
+    if (fstat(fd, &status) == 0)
+    {
+        length = static_cast<size_t>(status.st_size);
+        if (length == 0)
+            is_mapped = true;
+        else
+        {
+            void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                madvise(mapped, length, MADV_SEQUENTIAL);
+                address = static_cast<const char *>(mapped);
+                is_mapped = true;
+            }
+        }
+    }
+    close(fd); // the mapping stays valid
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (address)
+        UnmapViewOfFile(address);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+#else
+    if (address)
+        munmap(const_cast<char *>(address), length);
+#endif
+}
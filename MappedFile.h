@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // False if the file could not be opened or mapped; an empty file is open with no data
+    bool is_open() const
+    {
+        return is_mapped;
+    }
+
+    const char *data() const
+    {
+        return address;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    std::string_view view() const
+    {
+        return address ? std::string_view(address, length) : std::string_view();
+    }
+
+  private:
+    const char *address = nullptr;
+    size_t length = 0;
+    bool is_mapped = false;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
@@ -0,0 +1,393 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "MeshOptimizer.h"
+#include "MeshToGL.h"
+#include "MyGL/MeshClusters.h"
+
+struct MeshCache::Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t vertex_size; // layouts of the raw sections, which are only valid on the same platform
+    std::uint32_t arc_size;
+    std::uint32_t lod_size;
+    std::uint32_t has_graph;
+    std::uint32_t vertex_format;
+    std::uint32_t index_size;
+    std::uint64_t source_key;
+    std::uint64_t file_size;
+
+    std::uint64_t n_vertices;
+    std::uint64_t n_indices;
+    std::uint64_t n_arcs;
+    std::uint64_t n_lod_indices;
+    std::uint64_t n_lods;
+    double bbox_min[3];
+    double bbox_max[3];
+
+    // Byte offsets of the sections from the start of the file
+    std::uint64_t vertices_offset;
+    std::uint64_t vertex_ids_offset;
+    std::uint64_t positions_offset;
+    std::uint64_t normals_offset;
+    std::uint64_t indices_offset;
+    std::uint64_t lod_indices_offset;
+    std::uint64_t lods_offset;
+    std::uint64_t graph_offsets_offset;
+    std::uint64_t graph_arcs_offset;
+};
+
+namespace
+{
+constexpr char MAGIC[8] = {'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H'};
+constexpr std::uint32_t VERSION = 6;
+constexpr std::uint64_t SECTION_ALIGNMENT = 16;
+
+// Hash of the size and modification time of the source file, and of the format version
+std::optional<std::uint64_t> source_key(const std::string &source_filename)
+{
+    std::error_code error;
+    std::uint64_t size = std::filesystem::file_size(source_filename, error);
+    if (error)
+        return std::nullopt;
+    std::int64_t time = std::filesystem::last_write_time(source_filename, error).time_since_epoch().count();
+    if (error)
+        return std::nullopt;
+
+    // FNV-1a
+    std::uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const void *data, size_t size) {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<const unsigned char *>(data)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    add(&VERSION, sizeof(VERSION));
+    add(&size, sizeof(size));
+    add(&time, sizeof(time));
+    return hash;
+}
+
+std::uint64_t align(std::uint64_t offset)
+{
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+} // namespace
+
+MeshCache::MeshCache(const std::string &source_filename) : file(cache_filename(source_filename))
+{
+    if (!file.is_open() || file.size() < sizeof(Header))
+        return;
+
+    auto candidate = reinterpret_cast<const Header *>(file.data());
+    auto key = source_key(source_filename);
+    if (std::memcmp(candidate->magic, MAGIC, sizeof(MAGIC)) != 0 || candidate->version != VERSION ||
+        candidate->vertex_format > static_cast<std::uint32_t>(MyGL::VertexFormat::QUANTIZED_TEXTURED) ||
+        candidate->arc_size != sizeof(MeshGraph::Arc) || candidate->lod_size != sizeof(MyGL::MeshLods::Level) ||
+        !key || candidate->source_key != *key || candidate->file_size != file.size())
+        return;
+
+    // The GL mesh allocated for the cache picks its index type from the vertex count, the data must match it
+    auto format = static_cast<MyGL::VertexFormat>(candidate->vertex_format);
+    if (candidate->vertex_size != static_cast<std::uint32_t>(MyGL::Mesh::get_vertex_size(format)) ||
+        candidate->n_vertices > std::numeric_limits<GLuint>::max() ||
+        candidate->index_size != static_cast<std::uint32_t>(MyGL::Mesh::get_index_size(
+                                     MyGL::Mesh::get_index_type(static_cast<GLuint>(candidate->n_vertices)))))
+        return;
+
+    // A truncated or corrupted file must not lead to reads past the mapping
+    auto fits = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t element_size) {
+        return offset <= file.size() && count <= (file.size() - offset) / element_size;
+    };
+    if (!fits(candidate->vertices_offset, candidate->n_vertices, candidate->vertex_size) ||
+        !fits(candidate->vertex_ids_offset, candidate->n_vertices, sizeof(GLuint)) ||
+        !fits(candidate->positions_offset, candidate->n_vertices, 3 * sizeof(double)) ||
+        !fits(candidate->normals_offset, candidate->n_vertices, 3 * sizeof(double)) ||
+        !fits(candidate->indices_offset, candidate->n_indices, candidate->index_size) ||
+        !fits(candidate->lod_indices_offset, candidate->n_lod_indices, candidate->index_size) ||
+        !fits(candidate->lods_offset, candidate->n_lods, sizeof(MyGL::MeshLods::Level)) ||
+        (candidate->has_graph &&
+         (!fits(candidate->graph_offsets_offset, candidate->n_vertices + 1, sizeof(MeshGraph::Index)) ||
+          !fits(candidate->graph_arcs_offset, candidate->n_arcs, sizeof(MeshGraph::Arc)))))
+        return;
+
+    // Indices and vertex ids are used to rebuild the mesh, so they are checked like the section bounds
+    for (auto id : section<GLuint>(candidate->vertex_ids_offset, candidate->n_vertices))
+        if (id >= candidate->n_vertices)
+            return;
+    for (size_t k = 0; k < candidate->n_indices; ++k)
+        if (read_index(candidate, k) >= candidate->n_vertices)
+            return;
+
+    // The cached graph is searched without further checks, its rows must be in order and its arcs in bounds
+    if (candidate->has_graph)
+    {
+        auto offsets = section<MeshGraph::Index>(candidate->graph_offsets_offset, candidate->n_vertices + 1);
+        if (offsets.front() != 0 || offsets.back() != candidate->n_arcs ||
+            !std::is_sorted(offsets.begin(), offsets.end()))
+            return;
+        for (const auto &arc : section<MeshGraph::Arc>(candidate->graph_arcs_offset, candidate->n_arcs))
+            if (arc.to >= candidate->n_vertices)
+                return;
+    }
+
+    // Levels of detail are only drawn, their indices must be in bounds and their ranges whole triangles
+    for (size_t k = 0; k < candidate->n_lod_indices; ++k)
+        if (read_lod_index(candidate, k) >= candidate->n_vertices)
+            return;
+    for (const auto &lod : section<MyGL::MeshLods::Level>(candidate->lods_offset, candidate->n_lods))
+        if (lod.range.first % 3 != 0 || lod.range.count % 3 != 0 || lod.range.first > candidate->n_lod_indices ||
+            lod.range.count > candidate->n_lod_indices - lod.range.first)
+            return;
+
+    header = candidate;
+}
+
+bool MeshCache::write(const std::string &source_filename, const Mesh &mesh, const MeshGraph *graph,
+                      std::span<const GLuint> lod_indices, std::span<const MyGL::MeshLods::Level> lods)
+{
+    auto key = source_key(source_filename);
+    if (!key)
+        return false;
+
+    std::vector<double> positions, normals;
+    positions.reserve(3 * mesh.n_vertices());
+    normals.reserve(3 * mesh.n_vertices());
+    Eigen::Vector3d min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    Eigen::Vector3d max = Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+    for (const auto &v : mesh.vertices())
+    {
+        const auto &point = mesh.point(v);
+        positions.insert(positions.end(), {point[0], point[1], point[2]});
+        auto normal = mesh.has_vertex_normals() ? mesh.normal(v) : Mesh::Normal(0.0, 0.0, 0.0);
+        normals.insert(normals.end(), {normal[0], normal[1], normal[2]});
+        min = min.cwiseMin(point);
+        max = max.cwiseMax(point);
+    }
+
+    // The GL buffers are stored in GPU-friendly order, the mesh keeps its own. They are optimized as floats and
+    // then converted to the compact format and index type
+    auto vertices = MeshToGL::vertices(mesh);
+    auto indices = MeshToGL::indices(mesh);
+    MeshOptimizer::build_clusters(indices, vertices, MyGL::MeshClusters::CLUSTER_TRIANGLES);
+    MeshOptimizer::sort_clusters(indices, vertices, MyGL::MeshClusters::CLUSTER_TRIANGLES);
+    auto vertex_ids = MeshOptimizer::optimize_vertex_fetch(vertices, indices);
+
+    auto quantization = MeshToGL::Quantization::from_bbox(min, max);
+    auto format = MeshToGL::select_format(mesh, quantization);
+    auto index_type = MyGL::Mesh::get_index_type(static_cast<GLuint>(vertices.size()));
+    auto vertex_data = MeshToGL::convert_vertices(vertices, format, quantization);
+    auto index_data = MeshToGL::convert_indices(indices, index_type);
+
+    // The levels of detail refer to the mesh vertices, like the indices before optimization
+    std::vector<GLuint> gl_vertex(vertex_ids.size());
+    for (size_t v = 0; v < vertex_ids.size(); ++v)
+        gl_vertex[vertex_ids[v]] = static_cast<GLuint>(v);
+    std::vector<GLuint> gl_lod_indices(lod_indices.size());
+    for (size_t k = 0; k < lod_indices.size(); ++k)
+        gl_lod_indices[k] = gl_vertex[lod_indices[k]];
+    auto lod_index_data = MeshToGL::convert_indices(gl_lod_indices, index_type);
+
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.vertex_size = MyGL::Mesh::get_vertex_size(format);
+    header.arc_size = sizeof(MeshGraph::Arc);
+    header.lod_size = sizeof(MyGL::MeshLods::Level);
+    header.has_graph = graph != nullptr;
+    header.vertex_format = static_cast<std::uint32_t>(format);
+    header.index_size = MyGL::Mesh::get_index_size(index_type);
+    header.source_key = *key;
+    header.n_vertices = vertices.size();
+    header.n_indices = indices.size();
+    header.n_arcs = graph ? graph->n_arcs() : 0;
+    header.n_lod_indices = lod_indices.size();
+    header.n_lods = lods.size();
+    for (int i = 0; i < 3; ++i)
+    {
+        header.bbox_min[i] = min[i];
+        header.bbox_max[i] = max[i];
+    }
+
+    // Sections in file order, each starting at an aligned offset
+    struct Section
+    {
+        std::uint64_t *offset;
+        const void *data;
+        std::uint64_t size;
+    };
+    std::vector<Section> sections = {
+        {&header.vertices_offset, vertex_data.data(), vertex_data.size()},
+        {&header.vertex_ids_offset, vertex_ids.data(), vertex_ids.size() * sizeof(GLuint)},
+        {&header.positions_offset, positions.data(), positions.size() * sizeof(double)},
+        {&header.normals_offset, normals.data(), normals.size() * sizeof(double)},
+        {&header.indices_offset, index_data.data(), index_data.size()},
+        {&header.lod_indices_offset, lod_index_data.data(), lod_index_data.size()},
+        {&header.lods_offset, lods.data(), lods.size() * sizeof(MyGL::MeshLods::Level)},
+    };
+    if (graph)
+    {
+        sections.push_back({&header.graph_offsets_offset, graph->get_offsets().data(),
+                            graph->get_offsets().size() * sizeof(MeshGraph::Index)});
+        sections.push_back(
+            {&header.graph_arcs_offset, graph->get_arcs().data(), graph->get_arcs().size() * sizeof(MeshGraph::Arc)});
+    }
+
+    std::uint64_t offset = sizeof(Header);
+    for (auto &section : sections)
+    {
+        *section.offset = align(offset);
+        offset = *section.offset + section.size;
+    }
+    header.file_size = offset;
+
+    // Written under a temporary name and renamed, so that a reader never maps a partially written cache
+    auto filename = cache_filename(source_filename);
+    auto temporary_filename = filename + ".tmp";
+    {
+        std::ofstream out(temporary_filename, std::ios::binary);
+        if (!out)
+            return false;
+
+        const char padding[SECTION_ALIGNMENT] = {};
+        out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        offset = sizeof(Header);
+        for (const auto &section : sections)
+        {
+            out.write(padding, *section.offset - offset);
+            out.write(static_cast<const char *>(section.data), section.size);
+            offset = *section.offset + section.size;
+        }
+        if (!out)
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_filename, filename, error);
+    return !error;
+}
+
+size_t MeshCache::n_vertices() const
+{
+    return header->n_vertices;
+}
+
+size_t MeshCache::n_indices() const
+{
+    return header->n_indices;
+}
+
+MyGL::VertexFormat MeshCache::get_vertex_format() const
+{
+    return static_cast<MyGL::VertexFormat>(header->vertex_format);
+}
+
+std::span<const std::byte> MeshCache::get_vertex_data() const
+{
+    return section<std::byte>(header->vertices_offset, header->n_vertices * header->vertex_size);
+}
+
+std::span<const std::byte> MeshCache::get_index_data() const
+{
+    return section<std::byte>(header->indices_offset, header->n_indices * header->index_size);
+}
+
+std::span<const std::byte> MeshCache::get_lod_index_data() const
+{
+    return section<std::byte>(header->lod_indices_offset, header->n_lod_indices * header->index_size);
+}
+
+std::span<const MyGL::MeshLods::Level> MeshCache::get_lods() const
+{
+    return section<MyGL::MeshLods::Level>(header->lods_offset, header->n_lods);
+}
+
+std::vector<GLuint> MeshCache::get_indices() const
+{
+    std::vector<GLuint> indices(header->n_indices);
+    for (size_t k = 0; k < indices.size(); ++k)
+        indices[k] = read_index(header, k);
+    return indices;
+}
+
+std::span<const GLuint> MeshCache::get_vertex_ids() const
+{
+    return section<GLuint>(header->vertex_ids_offset, header->n_vertices);
+}
+
+Eigen::Vector3d MeshCache::get_bbox_min() const
+{
+    return Eigen::Vector3d(header->bbox_min[0], header->bbox_min[1], header->bbox_min[2]);
+}
+
+Eigen::Vector3d MeshCache::get_bbox_max() const
+{
+    return Eigen::Vector3d(header->bbox_max[0], header->bbox_max[1], header->bbox_max[2]);
+}
+
+GLuint MeshCache::read_index(const Header *header, size_t k) const
+{
+    if (header->index_size == sizeof(GLushort))
+        return section<GLushort>(header->indices_offset, header->n_indices)[k];
+    return section<GLuint>(header->indices_offset, header->n_indices)[k];
+}
+
+GLuint MeshCache::read_lod_index(const Header *header, size_t k) const
+{
+    if (header->index_size == sizeof(GLushort))
+        return section<GLushort>(header->lod_indices_offset, header->n_lod_indices)[k];
+    return section<GLuint>(header->lod_indices_offset, header->n_lod_indices)[k];
+}
+
+bool MeshCache::has_graph() const
+{
+    return header->has_graph != 0;
+}
+
+MeshGraph MeshCache::get_graph() const
+{
+    auto offsets = section<MeshGraph::Index>(header->graph_offsets_offset, header->n_vertices + 1);
+    auto arcs = section<MeshGraph::Arc>(header->graph_arcs_offset, header->n_arcs);
+    return MeshGraph(std::vector<MeshGraph::Index>(offsets.begin(), offsets.end()),
+                     std::vector<MeshGraph::Arc>(arcs.begin(), arcs.end()));
+}
+
+void MeshCache::build_mesh(Mesh &mesh) const
+{
+    auto positions = section<double>(header->positions_offset, 3 * header->n_vertices);
+    auto normals = section<double>(header->normals_offset, 3 * header->n_vertices);
+    auto vertex_ids = get_vertex_ids();
+
+    mesh.clear();
+    mesh.reserve(header->n_vertices, header->n_indices, header->n_indices / 3);
+    for (size_t v = 0; v < header->n_vertices; ++v)
+        mesh.add_vertex(Mesh::Point(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]));
+
+    // Checked again here, add_face must never see a vertex that was not added
+    auto vertex = [&](size_t k) {
+        GLuint index = read_index(header, k);
+        if (index >= header->n_vertices || vertex_ids[index] >= header->n_vertices)
+            throw std::runtime_error("Mesh cache index out of range");
+        return Mesh::VertexHandle(static_cast<int>(vertex_ids[index]));
+    };
+    for (size_t i = 0; i + 2 < header->n_indices; i += 3)
+        mesh.add_face(vertex(i), vertex(i + 1), vertex(i + 2));
+
+    // The exact normals, the GL ones may be quantized
+    if (mesh.has_vertex_normals())
+        for (size_t v = 0; v < header->n_vertices; ++v)
+            mesh.set_normal(Mesh::VertexHandle(static_cast<int>(v)),
+                            Mesh::Normal(normals[3 * v], normals[3 * v + 1], normals[3 * v + 2]));
+    if (mesh.has_face_normals())
+        mesh.update_face_normals();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "MeshGraph.h"
+#include "MyGL/Mesh.h"
+#include "MyGL/MeshLods.h"
+
+// Versioned binary cache of a loaded mesh, written next to its source file and memory-mapped on later launches.
+// It holds what startup needs without parsing or recomputing anything: the GL vertex and index buffers ready for
+// upload, in the vertex format and index type selected for the mesh, the exact positions and normals, the bounding
+// box and optionally the CSR graph. Boundaries are not stored, the rebuilt topology answers them.
+// The GL triangles are grouped into the culling clusters of MyGL::MeshClusters, ordered for the vertex cache within
+// each cluster and for overdraw across them, and the vertices for fetch, so GL vertex indices differ from the mesh
+// vertex indices, which positions and the graph keep.
+// Levels of detail are stored as index lists over the same GL vertices, each range relative to their section.
+// A cache is stale as soon as the size or modification time of the source file changes.
+class MeshCache
+{
+  public:
+    // Maps the cache of the source file, if there is an up to date one
+    explicit MeshCache(const std::string &source_filename);
+
+    // Writes the cache of the source file, from the mesh loaded from it with its vertex normals computed, and
+    // optionally its levels of detail over the mesh vertices. Returns false if the cache cannot be written
+    static bool write(const std::string &source_filename, const Mesh &mesh, const MeshGraph *graph = nullptr,
+                      std::span<const GLuint> lod_indices = {}, std::span<const MyGL::MeshLods::Level> lods = {});
+
+    static std::string cache_filename(const std::string &source_filename)
+    {
+        return source_filename + ".cache";
+    }
+
+    bool is_valid() const
+    {
+        return header != nullptr;
+    }
+
+    size_t n_vertices() const;
+    size_t n_indices() const;
+
+    // Format of the vertex data, quantized against the bounding box. The index type follows the vertex count
+    MyGL::VertexFormat get_vertex_format() const;
+
+    // Views into the mapping, valid as long as the cache object lives
+    std::span<const std::byte> get_vertex_data() const;
+    std::span<const std::byte> get_index_data() const;
+    std::span<const GLuint> get_vertex_ids() const; // mesh vertex of each GL vertex
+    std::span<const std::byte> get_lod_index_data() const;
+    std::span<const MyGL::MeshLods::Level> get_lods() const; // ranges of the level of detail indices
+
+    std::vector<GLuint> get_indices() const; // copied out of the mapping, whatever the index size
+
+    Eigen::Vector3d get_bbox_min() const;
+    Eigen::Vector3d get_bbox_max() const;
+
+    bool has_graph() const;
+    MeshGraph get_graph() const; // copied out of the mapping
+
+    // Rebuilds the half-edge mesh, with vertex normals if the mesh has requested them
+    void build_mesh(Mesh &mesh) const;
+
+  private:
+    struct Header;
+
+    MappedFile file;
+    const Header *header = nullptr;
+
+    template <typename T> std::span<const T> section(std::uint64_t offset, std::uint64_t count) const
+    {
+        return std::span<const T>(reinterpret_cast<const T *>(file.data() + offset), count);
+    }
+
+    // Index k of the index or level of detail index section, in either index size
+    GLuint read_index(const Header *header, size_t k) const;
+    GLuint read_lod_index(const Header *header, size_t k) const;
+};
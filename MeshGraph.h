@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Mesh.h"
+#include <OpenMesh/Core/Utils/PropertyManager.hh>
+
+// Compressed sparse row snapshot of the vertex adjacency of a mesh, with precomputed edge weights.
+// The snapshot is built once and can then be shared by any number of shortest path queries;
+// it does not track later changes to the mesh.
+template <typename Weight> class MeshGraphT
+{
+  public:
+    using Index = std::uint32_t;
+    using EdgeWeightFunc = std::function<double(Mesh::EdgeHandle)>;
+
+    // Each undirected edge is stored as two arcs, one in the row of each of its end points
+    struct Arc
+    {
+        Index to;
+        Weight weight;
+    };
+
+    // Use Euclidean distance as edge weight by default
+    explicit MeshGraphT(const Mesh &mesh)
+    {
+        build(mesh, [&mesh](Mesh::EdgeHandle e) -> double {
+            auto he = mesh.halfedge_handle(e, 0);
+            return (mesh.point(mesh.to_vertex_handle(he)) - mesh.point(mesh.from_vertex_handle(he))).norm();
+        });
+    }
+
+    MeshGraphT(const Mesh &mesh, const EdgeWeightFunc &edge_weight)
+    {
+        build(mesh, edge_weight);
+    }
+
+    // Use edge weights from the given property
+    MeshGraphT(const Mesh &mesh, const OpenMesh::EProp<double> &weights)
+    {
+        build(mesh, [&weights](Mesh::EdgeHandle e) -> double { return weights[e]; });
+    }
+
+    // Adopt raw CSR arrays, e.g. of a coarsened graph or of one read back from a file
+    MeshGraphT(std::vector<Index> offsets, std::vector<Arc> arcs) : offsets(std::move(offsets)), arcs(std::move(arcs))
+    {
+        if (this->offsets.empty() || this->offsets.back() != this->arcs.size())
+            throw std::runtime_error("Mesh graph build failed: offsets do not match the arcs");
+    }
+
+    size_t n_vertices() const
+    {
+        return offsets.size() - 1;
+    }
+
+    size_t n_arcs() const
+    {
+        return arcs.size();
+    }
+
+    const Arc *arcs_begin(Index vertex) const
+    {
+        return arcs.data() + offsets[vertex];
+    }
+
+    const Arc *arcs_end(Index vertex) const
+    {
+        return arcs.data() + offsets[vertex + 1];
+    }
+
+    template <typename Visitor> void for_each_neighbor(Index vertex, Visitor &&visit) const
+    {
+        for (auto arc = arcs_begin(vertex), end = arcs_end(vertex); arc != end; ++arc)
+            visit(arc->to, static_cast<double>(arc->weight));
+    }
+
+    const std::vector<Index> &get_offsets() const
+    {
+        return offsets;
+    }
+
+    const std::vector<Arc> &get_arcs() const
+    {
+        return arcs;
+    }
+
+  private:
+    std::vector<Index> offsets; // row start of each vertex, plus one past the last row
+    std::vector<Arc> arcs;
+
+    template <typename WeightFunc> void build(const Mesh &mesh, const WeightFunc &edge_weight)
+    {
+        if (2 * mesh.n_edges() > std::numeric_limits<Index>::max())
+            throw std::runtime_error("Mesh graph build failed: too many edges for 32-bit indices");
+
+        offsets.assign(mesh.n_vertices() + 1, 0);
+        for (const auto &v : mesh.vertices())
+            offsets[v.idx() + 1] = mesh.valence(v);
+        for (size_t i = 1; i < offsets.size(); ++i)
+            offsets[i] += offsets[i - 1];
+
+        arcs.resize(offsets.back());
+        for (const auto &v : mesh.vertices())
+        {
+            auto arc = arcs.begin() + offsets[v.idx()];
+            for (const auto &half_edge : mesh.voh_range(v))
+                *arc++ = {static_cast<Index>(mesh.to_vertex_handle(half_edge).idx()),
+                          static_cast<Weight>(edge_weight(half_edge.edge()))};
+        }
+    }
+};
+
+using MeshGraph = MeshGraphT<double>;
+using MeshGraphF = MeshGraphT<float>;
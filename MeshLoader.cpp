@@ -0,0 +1,280 @@
+#include "MeshLoader.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "MeshSimplifier.h"
+#include "MeshToGL.h"
+#include "ObjReader.h"
+
+namespace
+{
+// Number of vertices or faces uploaded per frame, a few milliseconds of conversion
+constexpr size_t UPLOAD_CHUNK_SIZE = size_t(1) << 18;
+
+class Cancelled
+{
+};
+} // namespace
+
+MeshLoader::MeshLoader(const std::string &filename, Mesh &mesh) : filename(filename), mesh(mesh)
+{
+    worker = std::thread(&MeshLoader::load, this);
+}
+
+MeshLoader::~MeshLoader()
+{
+    cancelled = true;
+    worker.join();
+}
+
+std::optional<MeshLoader::Layout> MeshLoader::get_layout() const
+{
+    std::lock_guard lock(mutex);
+    return layout;
+}
+
+bool MeshLoader::upload(MyGL::Mesh &gl_mesh)
+{
+    auto layout = get_layout();
+    if (!layout)
+        return false;
+
+    if (cache)
+    {
+        // Straight from the mapping, in one go
+        if (uploaded_vertices == 0)
+        {
+            gl_mesh.upload_vertex_data(0, cache->get_vertex_data());
+            gl_mesh.upload_index_data(0, cache->get_index_data());
+            uploaded_vertices = layout->n_vertices;
+            uploaded_faces = layout->n_indices / 3;
+        }
+        else if (!lods && is_finished())
+            upload_lods(gl_mesh, *layout);
+        return lods.has_value();
+    }
+
+    // Converted from the mesh into the mapped buffers. All vertices first, so that every uploaded index refers to
+    // an uploaded vertex. The worker only reads the mesh from the moment the layout is set
+    size_t n_faces = layout->n_indices / 3;
+    if (uploaded_vertices < layout->n_vertices)
+    {
+        size_t count = std::min(UPLOAD_CHUNK_SIZE, layout->n_vertices - uploaded_vertices);
+        MeshToGL::upload_vertices(mesh, gl_mesh, uploaded_vertices, count, layout->quantization);
+        uploaded_vertices += count;
+    }
+    else if (uploaded_faces < n_faces)
+    {
+        size_t count = std::min(UPLOAD_CHUNK_SIZE, n_faces - uploaded_faces);
+        MeshToGL::upload_faces(mesh, gl_mesh, uploaded_faces, count);
+        uploaded_faces += count;
+    }
+    else if (!lods && is_finished())
+        upload_lods(gl_mesh, *layout);
+    return lods.has_value();
+}
+
+void MeshLoader::upload_lods(MyGL::Mesh &gl_mesh, const Layout &layout)
+{
+    GLuint first = static_cast<GLuint>(layout.n_indices);
+    if (!lod_levels.empty())
+        first = cache ? gl_mesh.append_lod_index_data(cache->get_lod_index_data())
+                      : gl_mesh.append_lod_indices(lod_indices);
+
+    std::vector<MyGL::MeshLods::Level> levels = {{{0, static_cast<GLuint>(layout.n_indices)}, 0.0f}};
+    for (auto level : lod_levels)
+    {
+        level.range.first += first;
+        levels.push_back(level);
+    }
+
+    Eigen::Vector3d center = (layout.bbox_min + layout.bbox_max) / 2.0;
+    float radius = static_cast<float>((layout.bbox_max - layout.bbox_min).norm() / 2.0);
+    lods.emplace(std::move(levels), glm::vec3(center[0], center[1], center[2]), radius);
+}
+
+std::vector<std::string> MeshLoader::take_messages()
+{
+    std::lock_guard lock(mutex);
+    return std::exchange(messages, {});
+}
+
+std::string MeshLoader::get_status() const
+{
+    std::lock_guard lock(mutex);
+    return status;
+}
+
+void MeshLoader::load()
+{
+    try
+    {
+        cache.emplace(filename);
+        if (cache->is_valid())
+            load_cache();
+        else
+        {
+            cache.reset();
+            load_file();
+        }
+    }
+    catch (const Cancelled &)
+    {
+        error = "Loading cancelled";
+    }
+    catch (const std::exception &e)
+    {
+        error = e.what();
+    }
+    finished.store(true, std::memory_order_release);
+}
+
+void MeshLoader::load_cache()
+{
+    // The GL buffers are uploaded straight from the mapping, the topology is rebuilt meanwhile
+    set_layout({cache->n_vertices(), cache->n_indices(), cache->get_bbox_min(), cache->get_bbox_max(),
+                cache->get_vertex_format(),
+                MeshToGL::Quantization::from_bbox(cache->get_bbox_min(), cache->get_bbox_max())});
+
+    set_status("Building topology", 0.1f);
+    vertex_ids.assign(cache->get_vertex_ids().begin(), cache->get_vertex_ids().end());
+    cache->build_mesh(mesh);
+    graph = std::make_unique<MeshGraph>(cache->has_graph() ? cache->get_graph() : MeshGraph(mesh));
+
+    set_status("Building clusters", 0.5f);
+    build_clusters(cache->get_indices());
+    lod_levels.assign(cache->get_lods().begin(), cache->get_lods().end());
+
+    set_status("Building BVH", 0.55f);
+    build_bvh(cache->get_indices());
+
+    set_status("Computing landmarks", 0.6f);
+    landmarks.emplace(*graph);
+
+    set_status("Building path hierarchy", 0.8f);
+    build_path_hierarchy();
+    set_status("Done", 1.0f);
+}
+
+void MeshLoader::load_file()
+{
+    set_status("Reading " + filename, 0.0f);
+    if (!ObjReader::read(mesh, filename))
+        throw std::runtime_error("Failed to read mesh from file");
+
+    // Compute normals (for Phong shading)
+    set_status("Computing normals", 0.3f);
+    mesh.update_normals();
+
+    Eigen::Vector3d min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    Eigen::Vector3d max = Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+    for (const auto &v : mesh.vertices())
+    {
+        const auto &point = mesh.point(v);
+        min = min.cwiseMin(point);
+        max = max.cwiseMax(point);
+    }
+
+    auto quantization = MeshToGL::Quantization::from_bbox(min, max);
+    set_layout({mesh.n_vertices(), 3 * mesh.n_faces(), min, max, MeshToGL::select_format(mesh, quantization),
+                quantization});
+
+    set_status("Building graph", 0.4f);
+    graph = std::make_unique<MeshGraph>(mesh);
+
+    set_status("Building levels of detail", 0.5f);
+    auto indices = MeshToGL::indices(mesh);
+    build_lods(indices);
+    if (!MeshCache::write(filename, mesh, &*graph, lod_indices, lod_levels))
+    {
+        std::lock_guard lock(mutex);
+        messages.push_back("Failed to write mesh cache " + MeshCache::cache_filename(filename));
+    }
+
+    set_status("Building clusters", 0.6f);
+    build_clusters(indices);
+
+    set_status("Building BVH", 0.65f);
+    build_bvh(indices);
+
+    set_status("Computing landmarks", 0.7f);
+    landmarks.emplace(*graph);
+
+    set_status("Building path hierarchy", 0.8f);
+    build_path_hierarchy();
+    set_status("Done", 1.0f);
+}
+
+std::vector<glm::vec3> MeshLoader::gl_positions() const
+{
+    // Exact positions in GL vertex order, the GL ones may be quantized
+    std::vector<glm::vec3> positions(mesh.n_vertices());
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        const auto &point = mesh.point(Mesh::VertexHandle(vertex_ids.empty() ? int(i) : int(vertex_ids[i])));
+        positions[i] = glm::vec3(point[0], point[1], point[2]);
+    }
+    return positions;
+}
+
+void MeshLoader::build_clusters(std::span<const GLuint> indices)
+{
+    clusters.emplace(gl_positions(), indices);
+}
+
+void MeshLoader::build_bvh(std::span<const GLuint> indices)
+{
+    bvh.emplace(gl_positions(), indices);
+}
+
+void MeshLoader::build_lods(std::span<const GLuint> indices)
+{
+    for (auto &level : MeshSimplifier::build_lods(indices, gl_positions()))
+    {
+        auto first = static_cast<GLuint>(lod_indices.size());
+        lod_indices.insert(lod_indices.end(), level.indices.begin(), level.indices.end());
+        lod_levels.push_back({{first, static_cast<GLuint>(level.indices.size())}, level.error});
+    }
+}
+
+void MeshLoader::build_path_hierarchy()
+{
+    if (graph->n_vertices() < PATH_HIERARCHY_MIN_VERTICES)
+        return;
+
+    // Loaded from next to the mesh cache unless it was built for another graph
+    auto hierarchy_filename = PathHierarchy::cache_filename(filename);
+    path_hierarchy = PathHierarchy::load(hierarchy_filename, mesh, *graph);
+    if (path_hierarchy)
+        return;
+
+    path_hierarchy = std::make_unique<PathHierarchy>(mesh, *graph);
+    try
+    {
+        path_hierarchy->save(hierarchy_filename);
+    }
+    catch (const std::exception &e)
+    {
+        std::lock_guard lock(mutex);
+        messages.push_back(e.what());
+    }
+}
+
+void MeshLoader::set_status(const std::string &status, float progress)
+{
+    if (cancelled)
+        throw Cancelled();
+
+    std::lock_guard lock(mutex);
+    this->status = status;
+    this->progress = progress;
+}
+
+void MeshLoader::set_layout(const Layout &layout)
+{
+    std::lock_guard lock(mutex);
+    this->layout = layout;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Landmarks.h"
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshGraph.h"
+#include "MeshToGL.h"
+#include "MyGL/Mesh.h"
+#include "MyGL/MeshBVH.h"
+#include "MyGL/MeshClusters.h"
+#include "MyGL/MeshLods.h"
+#include "PathHierarchy.h"
+
+// Loads a mesh on a worker thread: from its binary cache if that is up to date, otherwise from the OBJ file,
+// writing the cache afterwards. As soon as the geometry is known, the GL thread uploads it a part per frame and
+// draws it, while the worker still builds the topology, the graph, the levels of detail, the picking hierarchy,
+// the landmarks and, for large meshes, the path hierarchy. The levels of detail are appended to the index buffer
+// once the worker is finished.
+class MeshLoader
+{
+  public:
+    // Sizes, bounding box and vertex format of the geometry, known once it can be uploaded
+    struct Layout
+    {
+        size_t n_vertices;
+        size_t n_indices;
+        Eigen::Vector3d bbox_min;
+        Eigen::Vector3d bbox_max;
+        MyGL::VertexFormat vertex_format;
+        MeshToGL::Quantization quantization; // of the bounding box, for the quantized formats
+    };
+
+    // Starts loading into the mesh, which must not be accessed until the loader is finished
+    MeshLoader(const std::string &filename, Mesh &mesh);
+    ~MeshLoader();
+
+    MeshLoader(const MeshLoader &) = delete;
+    MeshLoader &operator=(const MeshLoader &) = delete;
+
+    std::optional<Layout> get_layout() const;
+
+    // Uploads the next part of the geometry into a GL mesh allocated with the layout sizes and vertex format, and the
+    // position transform of the quantization, called on the GL thread every frame. Returns true once all of it is
+    // uploaded, the levels of detail last
+    bool upload(MyGL::Mesh &gl_mesh);
+
+    // Messages for the log, e.g. when the cache cannot be written
+    std::vector<std::string> take_messages();
+
+    // Current step of the loading and its progress in [0, 1]
+    std::string get_status() const;
+    float get_progress() const
+    {
+        return progress.load(std::memory_order_relaxed);
+    }
+
+    // True once the mesh, the graph and the landmarks are complete, or loading failed
+    bool is_finished() const
+    {
+        return finished.load(std::memory_order_acquire);
+    }
+
+    // Empty if loading succeeded, only meaningful once finished
+    const std::string &get_error() const
+    {
+        return error;
+    }
+
+    // Results of a successful load, taken once finished. The graph stays at the address the path hierarchy
+    // refers to
+    std::unique_ptr<MeshGraph> take_graph()
+    {
+        return std::move(graph);
+    }
+    Landmarks take_landmarks()
+    {
+        return std::move(*landmarks);
+    }
+
+    // Null below PATH_HIERARCHY_MIN_VERTICES, where A* with the landmarks is fast enough
+    std::unique_ptr<PathHierarchy> take_path_hierarchy()
+    {
+        return std::move(path_hierarchy);
+    }
+
+    // Mesh vertex of each GL vertex, empty if they are the same
+    std::vector<GLuint> take_vertex_ids()
+    {
+        return std::move(vertex_ids);
+    }
+
+    // Culling clusters of the GL buffers
+    MyGL::MeshClusters take_clusters()
+    {
+        return std::move(*clusters);
+    }
+
+    // Picking hierarchy over the triangles of the GL buffers
+    MyGL::MeshBVH take_bvh()
+    {
+        return std::move(*bvh);
+    }
+
+    // Levels of detail of the GL mesh, the full resolution first
+    MyGL::MeshLods take_lods()
+    {
+        return std::move(*lods);
+    }
+
+    static constexpr size_t PATH_HIERARCHY_MIN_VERTICES = size_t(1) << 20;
+
+  private:
+    std::string filename;
+    Mesh &mesh;
+
+    std::optional<MeshCache> cache; // kept if it is valid, its buffers are then uploaded as they are
+
+    // Upload progress, only used by the GL thread
+    size_t uploaded_vertices = 0;
+    size_t uploaded_faces = 0;
+
+    std::unique_ptr<MeshGraph> graph;
+    std::optional<Landmarks> landmarks;
+    std::unique_ptr<PathHierarchy> path_hierarchy;
+    std::vector<GLuint> vertex_ids;
+    std::optional<MyGL::MeshClusters> clusters;
+    std::optional<MyGL::MeshBVH> bvh;
+    std::vector<GLuint> lod_indices; // of the file, the ones of the cache are uploaded from the mapping
+    std::vector<MyGL::MeshLods::Level> lod_levels; // ranges relative to the level of detail indices
+    std::optional<MyGL::MeshLods> lods; // built by the GL thread once the indices are appended
+    std::string error;
+
+    mutable std::mutex mutex; // guards the members below
+    std::optional<Layout> layout;
+    std::vector<std::string> messages;
+    std::string status;
+
+    std::atomic<float> progress{0.0f};
+    std::atomic<bool> finished{false};
+    std::atomic<bool> cancelled{false};
+    std::thread worker;
+
+    void load();
+    void load_cache();
+    void load_file();
+    std::vector<glm::vec3> gl_positions() const;
+    void build_clusters(std::span<const GLuint> indices);
+    void build_bvh(std::span<const GLuint> indices);
+    void build_lods(std::span<const GLuint> indices);
+    void build_path_hierarchy();
+    void upload_lods(MyGL::Mesh &gl_mesh, const Layout &layout);
+
+    void set_status(const std::string &status, float progress);
+    void set_layout(const Layout &layout);
+};
@@ -0,0 +1,309 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace
+{
+constexpr GLuint UNUSED = std::numeric_limits<GLuint>::max();
+
+// Size of the LRU cache modelled by the Forsyth scores, larger than real caches so that the order degrades
+// gracefully on any of them
+constexpr int SCORE_CACHE_SIZE = 32;
+
+float vertex_score(int cache_position, unsigned remaining_triangles)
+{
+    if (remaining_triangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        // The vertices of the last triangle get a fixed score, so that its neighbours are not favoured
+        // over triangles reusing older vertices
+        if (cache_position < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - float(cache_position - 3) / (SCORE_CACHE_SIZE - 3), 1.5f);
+    }
+
+    // Vertices with few triangles left are finished off, instead of leaving lone triangles behind
+    return score + 2.0f / std::sqrt(float(remaining_triangles));
+}
+
+// Inserts two zero bits between the bits of a 10-bit value, for Morton codes
+std::uint32_t spread_bits(std::uint32_t x)
+{
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// Sorts the clusters of consecutive triangles starting at the given triangles, the last start being the triangle
+// count, so that clusters facing away from the center of the mesh are drawn first: they are likely in front
+void sort_by_facing(std::span<GLuint> indices, std::span<const MyGL::Vertex> vertices,
+                    const std::vector<size_t> &cluster_starts)
+{
+    // Area-weighted centroid and normal of each cluster
+    size_t n_clusters = cluster_starts.size() - 1;
+    std::vector<glm::vec3> centroids(n_clusters, glm::vec3(0.0f)), normals(n_clusters, glm::vec3(0.0f));
+    std::vector<float> areas(n_clusters, 0.0f);
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for (size_t c = 0; c < n_clusters; ++c)
+    {
+        for (size_t t = cluster_starts[c]; t < cluster_starts[c + 1]; ++t)
+        {
+            const auto &a = vertices[indices[3 * t]].position;
+            const auto &b = vertices[indices[3 * t + 1]].position;
+            const auto &d = vertices[indices[3 * t + 2]].position;
+            auto normal = glm::cross(b - a, d - a); // twice the area
+            float area = glm::length(normal);
+            centroids[c] += (a + b + d) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        mesh_centroid += centroids[c];
+        mesh_area += areas[c];
+        if (areas[c] > 0.0f)
+            centroids[c] = centroids[c] / areas[c];
+    }
+    if (mesh_area > 0.0f)
+        mesh_centroid = mesh_centroid / mesh_area;
+
+    std::vector<float> keys(n_clusters, 0.0f);
+    for (size_t c = 0; c < n_clusters; ++c)
+    {
+        float length = glm::length(normals[c]);
+        if (length > 0.0f)
+            keys[c] = glm::dot(centroids[c] - mesh_centroid, normals[c] / length);
+    }
+    std::vector<size_t> order(n_clusters);
+    for (size_t c = 0; c < n_clusters; ++c)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+    for (auto c : order)
+        output.insert(output.end(), indices.begin() + 3 * cluster_starts[c],
+                      indices.begin() + 3 * cluster_starts[c + 1]);
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+} // namespace
+
+void MeshOptimizer::optimize_vertex_cache(std::span<GLuint> indices, size_t n_vertices)
+{
+    size_t n_triangles = indices.size() / 3;
+    if (n_triangles == 0)
+        return;
+
+    // Triangles of each vertex, the ones not emitted yet first
+    std::vector<size_t> offsets(n_vertices + 1, 0);
+    for (auto index : indices)
+        offsets[index + 1]++;
+    for (size_t v = 0; v < n_vertices; ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<GLuint> vertex_triangles(indices.size());
+    std::vector<unsigned> remaining(n_vertices, 0);
+    for (size_t t = 0; t < n_triangles; ++t)
+        for (int k = 0; k < 3; ++k)
+        {
+            auto v = indices[3 * t + k];
+            vertex_triangles[offsets[v] + remaining[v]++] = static_cast<GLuint>(t);
+        }
+
+    std::vector<int> cache_position(n_vertices, -1);
+    std::vector<float> scores(n_vertices);
+    for (size_t v = 0; v < n_vertices; ++v)
+        scores[v] = vertex_score(-1, remaining[v]);
+
+    std::vector<float> triangle_scores(n_triangles);
+    for (size_t t = 0; t < n_triangles; ++t)
+        triangle_scores[t] = scores[indices[3 * t]] + scores[indices[3 * t + 1]] + scores[indices[3 * t + 2]];
+
+    std::vector<bool> is_emitted(n_triangles, false);
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+
+    std::vector<GLuint> cache, new_cache;
+    cache.reserve(SCORE_CACHE_SIZE + 3);
+    new_cache.reserve(SCORE_CACHE_SIZE + 3);
+
+    size_t best = std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin();
+    size_t next_unemitted = 0;
+    while (output.size() < indices.size())
+    {
+        // Without a cached candidate, continue with the next triangle in input order
+        if (best == n_triangles)
+        {
+            while (is_emitted[next_unemitted])
+                next_unemitted++;
+            best = next_unemitted;
+        }
+
+        const GLuint *triangle = &indices[3 * best];
+        output.insert(output.end(), triangle, triangle + 3);
+        is_emitted[best] = true;
+
+        // Moves the triangle past the remaining ones of its vertices
+        for (int k = 0; k < 3; ++k)
+        {
+            auto v = triangle[k];
+            auto begin = vertex_triangles.begin() + offsets[v];
+            auto end = begin + remaining[v];
+            auto position = std::find(begin, end, static_cast<GLuint>(best));
+            if (position != end) // not yet moved, for degenerate triangles
+            {
+                std::iter_swap(position, end - 1);
+                remaining[v]--;
+            }
+        }
+
+        // The triangle's vertices move to the front of the LRU cache
+        new_cache.assign(triangle, triangle + 3);
+        for (auto v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                new_cache.push_back(v);
+
+        for (size_t i = 0; i < new_cache.size(); ++i)
+        {
+            auto v = new_cache[i];
+            cache_position[v] = i < SCORE_CACHE_SIZE ? static_cast<int>(i) : -1;
+            scores[v] = vertex_score(cache_position[v], remaining[v]);
+        }
+
+        // Only the triangles of the updated vertices changed their score, the best cached one is emitted next
+        best = n_triangles;
+        float best_score = -std::numeric_limits<float>::infinity();
+        for (auto v : new_cache)
+            for (size_t i = offsets[v]; i < offsets[v] + remaining[v]; ++i)
+            {
+                auto t = vertex_triangles[i];
+                triangle_scores[t] =
+                    scores[indices[3 * t]] + scores[indices[3 * t + 1]] + scores[indices[3 * t + 2]];
+                if (cache_position[v] >= 0 && triangle_scores[t] > best_score)
+                {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+
+        new_cache.resize(std::min<size_t>(new_cache.size(), SCORE_CACHE_SIZE));
+        std::swap(cache, new_cache);
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void MeshOptimizer::build_clusters(std::span<GLuint> indices, std::span<const MyGL::Vertex> vertices,
+                                   size_t cluster_size)
+{
+    size_t n_triangles = indices.size() / 3;
+    if (n_triangles == 0)
+        return;
+
+    glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+    for (const auto &vertex : vertices)
+        for (int k = 0; k < 3; ++k)
+        {
+            min[k] = std::min(min[k], vertex.position[k]);
+            max[k] = std::max(max[k], vertex.position[k]);
+        }
+    float extent = std::max({max.x - min.x, max.y - min.y, max.z - min.z, std::numeric_limits<float>::min()});
+
+    // Morton code of each centroid, 10 bits per axis
+    std::vector<std::pair<std::uint32_t, GLuint>> codes(n_triangles);
+    for (size_t t = 0; t < n_triangles; ++t)
+    {
+        auto centroid = (vertices[indices[3 * t]].position + vertices[indices[3 * t + 1]].position +
+                         vertices[indices[3 * t + 2]].position) /
+                        3.0f;
+        std::uint32_t code = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            auto cell =
+                static_cast<std::uint32_t>(std::clamp((centroid[k] - min[k]) / extent * 1024.0f, 0.0f, 1023.0f));
+            code |= spread_bits(cell) << k;
+        }
+        codes[t] = {code, static_cast<GLuint>(t)};
+    }
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<GLuint> sorted(indices.size());
+    for (size_t t = 0; t < n_triangles; ++t)
+        std::copy_n(indices.begin() + 3 * codes[t].second, 3, sorted.begin() + 3 * t);
+
+    // Each cluster is optimized on its own, with its vertices renumbered from 0
+    std::vector<GLuint> local_index(vertices.size(), UNUSED);
+    std::vector<GLuint> global_index, local;
+    for (size_t first = 0; first < n_triangles; first += cluster_size)
+    {
+        auto cluster = std::span<GLuint>(sorted).subspan(3 * first, 3 * std::min(cluster_size, n_triangles - first));
+        global_index.clear();
+        local.resize(cluster.size());
+        for (size_t i = 0; i < cluster.size(); ++i)
+        {
+            if (local_index[cluster[i]] == UNUSED)
+            {
+                local_index[cluster[i]] = static_cast<GLuint>(global_index.size());
+                global_index.push_back(cluster[i]);
+            }
+            local[i] = local_index[cluster[i]];
+        }
+
+        optimize_vertex_cache(local, global_index.size());
+        for (size_t i = 0; i < cluster.size(); ++i)
+            cluster[i] = global_index[local[i]];
+        for (auto v : global_index)
+            local_index[v] = UNUSED;
+    }
+
+    std::copy(sorted.begin(), sorted.end(), indices.begin());
+}
+
+void MeshOptimizer::sort_clusters(std::span<GLuint> indices, std::span<const MyGL::Vertex> vertices,
+                                  size_t cluster_size)
+{
+    size_t n_triangles = indices.size() / 3;
+    if (n_triangles == 0)
+        return;
+
+    // MeshClusters cuts fixed-size clusters from the start, so a last partial one must stay last
+    size_t n_whole = n_triangles / cluster_size * cluster_size;
+    std::vector<size_t> cluster_starts;
+    for (size_t first = 0; first < n_whole; first += cluster_size)
+        cluster_starts.push_back(first);
+    cluster_starts.push_back(n_whole);
+    sort_by_facing(indices.first(3 * n_whole), vertices, cluster_starts);
+}
+
+std::vector<GLuint> MeshOptimizer::optimize_vertex_fetch(std::span<MyGL::Vertex> vertices, std::span<GLuint> indices)
+{
+    std::vector<GLuint> new_index(vertices.size(), UNUSED);
+    std::vector<GLuint> old_index;
+    old_index.reserve(vertices.size());
+
+    for (auto &index : indices)
+    {
+        if (new_index[index] == UNUSED)
+        {
+            new_index[index] = static_cast<GLuint>(old_index.size());
+            old_index.push_back(index);
+        }
+        index = new_index[index];
+    }
+    for (size_t v = 0; v < vertices.size(); ++v)
+        if (new_index[v] == UNUSED)
+            old_index.push_back(static_cast<GLuint>(v));
+
+    std::vector<MyGL::Vertex> reordered(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v)
+        reordered[v] = vertices[old_index[v]];
+    std::copy(reordered.begin(), reordered.end(), vertices.begin());
+    return old_index;
+}
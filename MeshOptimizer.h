@@ -0,0 +1,28 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "MyGL/Mesh.h"
+
+// Reorders GL triangle lists for the GPU: triangles for the post-transform vertex cache and for early depth
+// rejection, then vertices in the order they are fetched. The geometry drawn stays the same.
+class MeshOptimizer
+{
+  public:
+    // Forsyth's linear-speed vertex cache optimization, greedily emitting the triangle whose vertices are most
+    // recently used and have the fewest remaining triangles
+    static void optimize_vertex_cache(std::span<GLuint> indices, size_t n_vertices);
+
+    // Groups the triangles into spatially compact clusters of cluster_size consecutive triangles, for culling: the
+    // triangles are sorted along the Morton curve of their centroids, then each cluster is ordered for the vertex cache
+    static void build_clusters(std::span<GLuint> indices, std::span<const MyGL::Vertex> vertices, size_t cluster_size);
+
+    // Sorts the clusters built above so that outward-facing ones are drawn first and occlude the rest, keeping each
+    // one contiguous and a last partial cluster at the end
+    static void sort_clusters(std::span<GLuint> indices, std::span<const MyGL::Vertex> vertices, size_t cluster_size);
+
+    // Renumbers the vertices in the order the indices first use them, unused vertices last.
+    // Returns the previous index of each vertex
+    static std::vector<GLuint> optimize_vertex_fetch(std::span<MyGL::Vertex> vertices, std::span<GLuint> indices);
+};
@@ -0,0 +1,456 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+#include "MeshOptimizer.h"
+
+namespace
+{
+// Only the cheapest part of the candidate collapses is done per pass, the others are evaluated again with the
+// updated quadrics, so that features are not collapsed while flat regions could still be
+constexpr size_t PASS_CANDIDATE_DIVISOR = 3;
+
+// Sum of the squared distances to a set of planes, weighted by the areas of their triangles. In double, the sums
+// of many small areas lose too much in float
+struct Quadric
+{
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    void add_triangle(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+    {
+        glm::dvec3 normal = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+        double length = glm::length(normal);
+        if (length == 0.0)
+            return;
+        normal = normal / length;
+        double d = -glm::dot(normal, glm::dvec3(p0));
+        double area = 0.5 * length;
+
+        a00 += area * normal.x * normal.x;
+        a01 += area * normal.x * normal.y;
+        a02 += area * normal.x * normal.z;
+        a11 += area * normal.y * normal.y;
+        a12 += area * normal.y * normal.z;
+        a22 += area * normal.z * normal.z;
+        b0 += area * d * normal.x;
+        b1 += area * d * normal.y;
+        b2 += area * d * normal.z;
+        c += area * d * d;
+        weight += area;
+    }
+
+    Quadric &operator+=(const Quadric &other)
+    {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    // Mean squared distance of the point to the planes
+    double error(const glm::vec3 &point) const
+    {
+        if (weight == 0.0)
+            return 0.0;
+        double x = point.x, y = point.y, z = point.z;
+        double value = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                       2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return std::max(value, 0.0) / weight;
+    }
+};
+
+// Distance from a point to a triangle, through its closest point (Ericson, Real-Time Collision Detection 5.1.5)
+float distance_to_triangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return glm::length(ap);
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+        return glm::length(bp);
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return glm::length(ap - ab * (d1 / (d1 - d3)));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+        return glm::length(cp);
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return glm::length(ap - ac * (d2 / (d2 - d6)));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        return glm::length(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+
+    float denominator = va + vb + vc;
+    if (denominator <= 0.0f) // degenerate triangle, its edges were tested above
+        return glm::length(ap);
+    return glm::length(ap - ab * (vb / denominator) - ac * (vc / denominator));
+}
+
+struct Collapse
+{
+    double cost;
+    GLuint from;
+    GLuint to;
+};
+
+// Vertices on an edge with other than two triangles
+std::vector<bool> find_locked_vertices(std::span<const GLuint> indices, size_t n_vertices)
+{
+    std::vector<std::tuple<GLuint, GLuint>> edges;
+    edges.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3)
+        for (int k = 0; k < 3; ++k)
+        {
+            auto a = indices[i + k], b = indices[i + (k + 1) % 3];
+            edges.emplace_back(std::min(a, b), std::max(a, b));
+        }
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<bool> locked(n_vertices, false);
+    for (size_t begin = 0, end; begin < edges.size(); begin = end)
+    {
+        for (end = begin + 1; end < edges.size() && edges[end] == edges[begin]; ++end)
+            ;
+        if (end - begin != 2)
+        {
+            locked[std::get<0>(edges[begin])] = true;
+            locked[std::get<1>(edges[begin])] = true;
+        }
+    }
+    return locked;
+}
+
+class Simplifier
+{
+  public:
+    Simplifier(std::span<const GLuint> indices, std::span<const glm::vec3> positions)
+        : positions(positions), indices(indices.begin(), indices.end()), quadrics(positions.size()),
+          locked(find_locked_vertices(indices, positions.size())), representatives(positions.size()),
+          remap(positions.size()), touched(positions.size()), offsets(positions.size() + 1),
+          link_stamps(positions.size(), 0)
+    {
+        for (size_t v = 0; v < representatives.size(); ++v)
+            representatives[v] = static_cast<GLuint>(v);
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            Quadric quadric;
+            quadric.add_triangle(positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]]);
+            for (int k = 0; k < 3; ++k)
+                quadrics[indices[i + k]] += quadric;
+        }
+    }
+
+    const std::vector<GLuint> &get_indices() const
+    {
+        return indices;
+    }
+
+    // Largest distance of a removed vertex to the triangles around the vertex it was merged into and its neighbours,
+    // close to its distance to the simplified surface and never below it. The quadrics average over their planes and
+    // underestimate it
+    float measure_error()
+    {
+        build_adjacency();
+
+        // Removed vertices grouped by representative
+        size_t n_vertices = positions.size();
+        std::vector<size_t> member_offsets(n_vertices + 1, 0);
+        for (size_t v = 0; v < n_vertices; ++v)
+            if (representatives[v] != v)
+                member_offsets[representatives[v] + 1]++;
+        for (size_t v = 0; v < n_vertices; ++v)
+            member_offsets[v + 1] += member_offsets[v];
+        std::vector<GLuint> members(member_offsets[n_vertices]);
+        {
+            std::vector<size_t> next(member_offsets.begin(), member_offsets.end() - 1);
+            for (size_t v = 0; v < n_vertices; ++v)
+                if (representatives[v] != v)
+                    members[next[representatives[v]]++] = static_cast<GLuint>(v);
+        }
+
+        float error = 0.0f;
+        std::vector<GLuint> nearby;
+        std::vector<size_t> stamps(indices.size() / 3, n_vertices);
+        for (size_t r = 0; r < n_vertices; ++r)
+        {
+            if (member_offsets[r] == member_offsets[r + 1])
+                continue;
+
+            // A part that collapsed entirely shrank to its representative
+            if (offsets[r] == offsets[r + 1])
+            {
+                for (size_t m = member_offsets[r]; m < member_offsets[r + 1]; ++m)
+                    error = std::max(error, glm::length(positions[members[m]] - positions[r]));
+                continue;
+            }
+
+            // Triangles sharing a vertex with a triangle of the representative, each once
+            nearby.clear();
+            for (size_t i = offsets[r]; i < offsets[r + 1]; ++i)
+                for (int k = 0; k < 3; ++k)
+                {
+                    auto u = indices[3 * vertex_triangles[i] + k];
+                    for (size_t j = offsets[u]; j < offsets[u + 1]; ++j)
+                        if (stamps[vertex_triangles[j]] != r)
+                        {
+                            stamps[vertex_triangles[j]] = r;
+                            nearby.push_back(vertex_triangles[j]);
+                        }
+                }
+
+            for (size_t m = member_offsets[r]; m < member_offsets[r + 1]; ++m)
+            {
+                const auto &point = positions[members[m]];
+                float distance = std::numeric_limits<float>::max();
+                for (auto t : nearby)
+                    distance = std::min(distance, distance_to_triangle(point, positions[indices[3 * t]],
+                                                                       positions[indices[3 * t + 1]],
+                                                                       positions[indices[3 * t + 2]]));
+                error = std::max(error, distance);
+            }
+        }
+        return error;
+    }
+
+    // Collapses edges until at most target_triangles remain, returns false once no edge can be collapsed
+    bool simplify(size_t target_triangles)
+    {
+        while (indices.size() / 3 > target_triangles)
+            if (collapse_pass(target_triangles) == 0)
+                return false;
+        return true;
+    }
+
+  private:
+    std::span<const glm::vec3> positions;
+    std::vector<GLuint> indices;
+    std::vector<Quadric> quadrics;
+    std::vector<bool> locked;
+    std::vector<GLuint> representatives; // vertex each original vertex was merged into, itself if it remains
+
+    // Scratch buffers of the passes
+    std::vector<GLuint> remap;
+    std::vector<bool> touched;
+    std::vector<size_t> offsets;
+    std::vector<GLuint> vertex_triangles;
+    std::vector<Collapse> collapses;
+    std::vector<size_t> link_stamps;
+    size_t link_stamp = 0;
+
+    // Triangles of each vertex
+    void build_adjacency()
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (auto index : indices)
+            offsets[index + 1]++;
+        for (size_t v = 0; v + 1 < offsets.size(); ++v)
+            offsets[v + 1] += offsets[v];
+
+        vertex_triangles.resize(indices.size());
+        std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            vertex_triangles[next[indices[i]]++] = static_cast<GLuint>(i / 3);
+    }
+
+    // Collapses a set of cheap edges far enough from each other that none changes the triangles another one
+    // checked. Returns the number of collapses
+    size_t collapse_pass(size_t target_triangles)
+    {
+        size_t n_vertices = positions.size();
+        size_t n_triangles = indices.size() / 3;
+        build_adjacency();
+
+        // Every edge once, in the cheaper of its allowed directions. An edge shared by two consistently oriented
+        // triangles appears once with its first vertex lower
+        collapses.clear();
+        for (size_t i = 0; i < indices.size(); i += 3)
+            for (int k = 0; k < 3; ++k)
+            {
+                auto a = indices[i + k], b = indices[i + (k + 1) % 3];
+                if (a > b || (locked[a] && locked[b]))
+                    continue;
+
+                Quadric quadric = quadrics[a];
+                quadric += quadrics[b];
+                Collapse collapse{std::numeric_limits<double>::infinity(), a, b};
+                if (!locked[a])
+                    collapse = {quadric.error(positions[b]), a, b};
+                if (!locked[b])
+                {
+                    double cost = quadric.error(positions[a]);
+                    if (cost < collapse.cost)
+                        collapse = {cost, b, a};
+                }
+                collapses.push_back(collapse);
+            }
+        if (collapses.empty())
+            return 0;
+
+        size_t n_candidates = std::max<size_t>(1, collapses.size() / PASS_CANDIDATE_DIVISOR);
+        std::partial_sort(collapses.begin(), collapses.begin() + n_candidates, collapses.end(),
+                          [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+        for (size_t v = 0; v < n_vertices; ++v)
+            remap[v] = static_cast<GLuint>(v);
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t n_collapsed = 0;
+        for (size_t c = 0; c < n_candidates && n_triangles > target_triangles; ++c)
+        {
+            auto from = collapses[c].from, to = collapses[c].to;
+            if (touched[from] || touched[to] || breaks_link(from, to) || flips(from, to))
+                continue;
+
+            // The one-ring of the removed vertex is kept as it is for the rest of the pass
+            size_t removed = 0;
+            for (size_t i = offsets[from]; i < offsets[from + 1]; ++i)
+            {
+                const GLuint *triangle = &indices[3 * vertex_triangles[i]];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                    removed++;
+                for (int k = 0; k < 3; ++k)
+                    touched[triangle[k]] = true;
+            }
+
+            remap[from] = to;
+            quadrics[to] += quadrics[from];
+            n_triangles -= removed;
+            n_collapsed++;
+        }
+
+        // Triangles that lost an edge are dropped
+        size_t kept = 0;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            GLuint a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        indices.resize(kept);
+        for (auto &r : representatives)
+            r = remap[r];
+        return n_collapsed;
+    }
+
+    // Whether the collapse would pinch the surface: the one-rings of the two vertices may only share the vertices
+    // opposite their edge, and those must differ (the link condition, as in OpenMesh's is_collapse_ok)
+    bool breaks_link(GLuint from, GLuint to)
+    {
+        ++link_stamp;
+        GLuint opposite[2];
+        size_t n_opposite = 0;
+        for (size_t i = offsets[from]; i < offsets[from + 1]; ++i)
+        {
+            const GLuint *triangle = &indices[3 * vertex_triangles[i]];
+            bool has_edge = triangle[0] == to || triangle[1] == to || triangle[2] == to;
+            for (int k = 0; k < 3; ++k)
+            {
+                auto u = triangle[k];
+                if (u == from || u == to)
+                    continue;
+                link_stamps[u] = link_stamp;
+                if (has_edge)
+                {
+                    if (n_opposite == 2)
+                        return true; // the edge has more than two triangles
+                    opposite[n_opposite++] = u;
+                }
+            }
+        }
+        if (n_opposite == 2 && opposite[0] == opposite[1])
+            return true;
+
+        for (size_t i = offsets[to]; i < offsets[to + 1]; ++i)
+        {
+            const GLuint *triangle = &indices[3 * vertex_triangles[i]];
+            for (int k = 0; k < 3; ++k)
+            {
+                auto u = triangle[k];
+                if (u != from && u != to && link_stamps[u] == link_stamp &&
+                    std::find(opposite, opposite + n_opposite, u) == opposite + n_opposite)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether moving the vertex onto its neighbour would turn one of the remaining triangles around
+    bool flips(GLuint from, GLuint to) const
+    {
+        for (size_t i = offsets[from]; i < offsets[from + 1]; ++i)
+        {
+            const GLuint *triangle = &indices[3 * vertex_triangles[i]];
+            if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                continue;
+
+            glm::vec3 before[3], after[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                before[k] = positions[triangle[k]];
+                after[k] = triangle[k] == from ? positions[to] : before[k];
+            }
+            auto normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+            auto normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normal_before, normal_after) <= 0.0f)
+                return true;
+        }
+        return false;
+    }
+};
+} // namespace
+
+std::vector<MeshSimplifier::Level> MeshSimplifier::build_lods(std::span<const GLuint> indices,
+                                                               std::span<const glm::vec3> positions,
+                                                               size_t max_levels, size_t min_triangles)
+{
+    std::vector<Level> levels;
+    Simplifier simplifier(indices, positions);
+
+    size_t previous_triangles = indices.size() / 3;
+    while (levels.size() < max_levels && previous_triangles / 2 >= min_triangles)
+    {
+        bool is_complete = simplifier.simplify(previous_triangles / 2);
+
+        // A stuck simplification still gives a last level if it got far enough
+        size_t n_triangles = simplifier.get_indices().size() / 3;
+        if (!is_complete && 4 * n_triangles > 3 * previous_triangles)
+            break;
+
+        // Measured against the original vertices, a coarser level never has a smaller error
+        float error = simplifier.measure_error();
+        Level level{simplifier.get_indices(), levels.empty() ? error : std::max(error, levels.back().error)};
+        MeshOptimizer::optimize_vertex_cache(level.indices, positions.size());
+        levels.push_back(std::move(level));
+        previous_triangles = n_triangles;
+        if (!is_complete)
+            break;
+    }
+    return levels;
+}
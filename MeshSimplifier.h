@@ -0,0 +1,25 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Builds levels of detail of a GL triangle list by quadric error edge collapses. Each collapse merges a vertex into
+// a neighbour, so the simplified triangles keep referring to the original vertices and share their vertex buffer.
+// Vertices on boundaries and non-manifold edges are never removed, which keeps the outline of open meshes.
+class MeshSimplifier
+{
+  public:
+    struct Level
+    {
+        std::vector<GLuint> indices; // ordered for the vertex cache
+        float error; // estimated largest distance to the original surface, in the units of the positions
+    };
+
+    // Levels with about half the triangles of the previous one each, coarsest last, until max_levels are built, a level
+    // would have fewer than min_triangles or the mesh cannot be simplified further. The full resolution is not included
+    static std::vector<Level> build_lods(std::span<const GLuint> indices, std::span<const glm::vec3> positions,
+                                         size_t max_levels = 6, size_t min_triangles = 1024);
+};
@@ -1,38 +1,296 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
 #include "Mesh.h"
 #include "MyGL/Mesh.h"
 
 class MeshToGL
 {
   public:
-    static std::vector<MyGL::Vertex> vertices(const Mesh &mesh)
+    // Cube the quantized positions are fractions of, the bounding box grown to its longest side
+    struct Quantization
     {
-        std::vector<MyGL::Vertex> vertices;
-        vertices.reserve(mesh.n_vertices());
+        glm::vec3 origin{0.0f};
+        float extent = 1.0f;
+
+        static Quantization from_bbox(const Eigen::Vector3d &min, const Eigen::Vector3d &max)
+        {
+            float extent = static_cast<float>((max - min).maxCoeff());
+            return {glm::vec3(min[0], min[1], min[2]), extent > 0.0f ? extent : 1.0f};
+        }
 
-        const auto zero3d = Eigen::Vector3d(0.0f, 0.0f, 0.0f);
-        const auto zero2d = Eigen::Vector2d(0.0f, 0.0f);
+        // Maps the decoded [0, 1] positions to model space
+        glm::mat4 get_position_transform() const
+        {
+            return glm::translate(glm::mat4(1.0f), origin) * glm::scale(glm::mat4(1.0f), glm::vec3(extent));
+        }
+    };
 
-        for (const auto &v : mesh.vertices())
+    // The quantized formats when the quantization error stays below a hundredth of the mean edge length,
+    // with texture coordinates only if the mesh has them. The mesh must be loaded, its edges are measured
+    static MyGL::VertexFormat select_format(const Mesh &mesh, const Quantization &quantization)
+    {
+        double edge_length = 0.0;
+        for (const auto &e : mesh.edges())
         {
-            const auto &point = mesh.point(v);
-            const auto &normal = mesh.has_vertex_normals() ? mesh.normal(v) : zero3d;
-            const auto &tex_coord = mesh.has_vertex_texcoords2D() ? mesh.texcoord2D(v) : zero2d;
-            vertices.push_back(
-                {{point[0], point[1], point[2]}, {normal[0], normal[1], normal[2]}, {tex_coord[0], tex_coord[1]}});
+            auto he = mesh.halfedge_handle(e, 0);
+            edge_length += (mesh.point(mesh.to_vertex_handle(he)) - mesh.point(mesh.from_vertex_handle(he))).norm();
         }
+        edge_length /= std::max<size_t>(1, mesh.n_edges());
+
+        double max_error = quantization.extent / 65535.0 / 2.0;
+        if (mesh.n_edges() == 0 || max_error > 0.01 * edge_length)
+            return MyGL::VertexFormat::FLOAT;
+        return mesh.has_vertex_texcoords2D() ? MyGL::VertexFormat::QUANTIZED_TEXTURED : MyGL::VertexFormat::QUANTIZED;
+    }
+
+    static std::vector<MyGL::Vertex> vertices(const Mesh &mesh)
+    {
+        std::vector<MyGL::Vertex> vertices(mesh.n_vertices());
+        MeshToGL::vertices(mesh, 0, std::span<MyGL::Vertex>(vertices), Quantization());
         return vertices;
     }
 
     static std::vector<unsigned int> indices(const Mesh &mesh)
     {
-        std::vector<unsigned int> indices;
-        indices.reserve(mesh.n_faces() * 3);
-
-        for (const auto &f : mesh.faces())
-            for (const auto &v : mesh.fv_range(f))
-                indices.push_back(v.idx());
+        std::vector<unsigned int> indices(mesh.n_faces() * 3);
+        MeshToGL::indices(mesh, 0, std::span<unsigned int>(indices));
         return indices;
     }
-};
\ No newline at end of file
+
+    // Converts the vertices starting at the first one into the output, one per element, in any vertex format.
+    // Large ranges are split over num_threads threads, 0 uses all hardware threads
+    template <typename V>
+    static void vertices(const Mesh &mesh, size_t first, std::span<V> out, const Quantization &quantization,
+                         unsigned num_threads = 0)
+    {
+        // The attributes the mesh lacks are zeroed once, not tested per vertex
+        bool has_normals = mesh.has_vertex_normals();
+        bool has_tex_coords = mesh.has_vertex_texcoords2D();
+
+        parallel_for(out.size(), num_threads, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                auto v = Mesh::VertexHandle(static_cast<int>(first + i));
+                const auto &point = mesh.point(v);
+                MyGL::Vertex vertex;
+                vertex.position = glm::vec3(point[0], point[1], point[2]);
+                if (has_normals)
+                {
+                    const auto &normal = mesh.normal(v);
+                    vertex.normal = glm::vec3(normal[0], normal[1], normal[2]);
+                }
+                else
+                    vertex.normal = glm::vec3(0.0f);
+                if (has_tex_coords)
+                {
+                    const auto &tex_coord = mesh.texcoord2D(v);
+                    vertex.tex_coords = glm::vec2(tex_coord[0], tex_coord[1]);
+                }
+                else
+                    vertex.tex_coords = glm::vec2(0.0f);
+                encode(vertex, quantization, out[i]);
+            }
+        });
+    }
+
+    // Converts the triangles starting at the first face into the output, three indices per face
+    template <typename I>
+    static void indices(const Mesh &mesh, size_t first_face, std::span<I> out, unsigned num_threads = 0)
+    {
+        parallel_for(out.size() / 3, num_threads, [&](size_t begin, size_t end) {
+            auto index = out.begin() + 3 * begin;
+            for (size_t i = begin; i < end; ++i)
+                for (const auto &v : mesh.fv_range(Mesh::FaceHandle(static_cast<int>(first_face + i))))
+                    *index++ = static_cast<I>(v.idx());
+        });
+    }
+
+    // Converts float vertices to the given format, as raw buffer contents
+    static std::vector<std::byte> convert_vertices(std::span<const MyGL::Vertex> vertices, MyGL::VertexFormat format,
+                                                   const Quantization &quantization)
+    {
+        std::vector<std::byte> data(vertices.size() * MyGL::Mesh::get_vertex_size(format));
+        switch (format)
+        {
+        case MyGL::VertexFormat::FLOAT:
+            convert(vertices, as_span<MyGL::Vertex>(data), quantization);
+            break;
+        case MyGL::VertexFormat::QUANTIZED:
+            convert(vertices, as_span<MyGL::QuantizedVertex>(data), quantization);
+            break;
+        case MyGL::VertexFormat::QUANTIZED_TEXTURED:
+            convert(vertices, as_span<MyGL::QuantizedTexturedVertex>(data), quantization);
+            break;
+        }
+        return data;
+    }
+
+    static std::vector<std::byte> convert_indices(std::span<const GLuint> indices, GLenum index_type)
+    {
+        std::vector<std::byte> data(indices.size() * MyGL::Mesh::get_index_size(index_type));
+        if (index_type == GL_UNSIGNED_SHORT)
+            std::copy(indices.begin(), indices.end(), as_span<GLushort>(data).begin());
+        else
+            std::copy(indices.begin(), indices.end(), as_span<GLuint>(data).begin());
+        return data;
+    }
+
+    // Convert straight into the mapped buffers of the GL mesh, in its vertex format and index type, without
+    // intermediate arrays. The quantization must be the one of the GL mesh position transform
+    static void upload_vertices(const Mesh &mesh, MyGL::Mesh &gl_mesh, size_t first, size_t count,
+                                const Quantization &quantization, unsigned num_threads = 0)
+    {
+        auto data = gl_mesh.map_vertex_data(first, count);
+        switch (gl_mesh.get_vertex_format())
+        {
+        case MyGL::VertexFormat::FLOAT:
+            vertices(mesh, first, as_span<MyGL::Vertex>(data), quantization, num_threads);
+            break;
+        case MyGL::VertexFormat::QUANTIZED:
+            vertices(mesh, first, as_span<MyGL::QuantizedVertex>(data), quantization, num_threads);
+            break;
+        case MyGL::VertexFormat::QUANTIZED_TEXTURED:
+            vertices(mesh, first, as_span<MyGL::QuantizedTexturedVertex>(data), quantization, num_threads);
+            break;
+        }
+        gl_mesh.unmap_vertices();
+    }
+
+    static void upload_faces(const Mesh &mesh, MyGL::Mesh &gl_mesh, size_t first_face, size_t count,
+                             unsigned num_threads = 0)
+    {
+        auto data = gl_mesh.map_index_data(3 * first_face, 3 * count);
+        if (gl_mesh.get_index_type() == GL_UNSIGNED_SHORT)
+            indices(mesh, first_face, as_span<GLushort>(data), num_threads);
+        else
+            indices(mesh, first_face, as_span<GLuint>(data), num_threads);
+        gl_mesh.unmap_indices();
+    }
+
+  private:
+    // Below this many elements per thread, starting threads costs more than converting
+    static constexpr size_t MIN_ITEMS_PER_THREAD = size_t(1) << 14;
+
+    template <typename T> static std::span<T> as_span(std::span<std::byte> data)
+    {
+        return std::span<T>(reinterpret_cast<T *>(data.data()), data.size() / sizeof(T));
+    }
+
+    template <typename V>
+    static void convert(std::span<const MyGL::Vertex> in, std::span<V> out, const Quantization &quantization)
+    {
+        for (size_t i = 0; i < in.size(); ++i)
+            encode(in[i], quantization, out[i]);
+    }
+
+    static void encode(const MyGL::Vertex &in, const Quantization &, MyGL::Vertex &out)
+    {
+        out = in;
+    }
+
+    static void encode(const MyGL::Vertex &in, const Quantization &quantization, MyGL::QuantizedVertex &out)
+    {
+        quantize_position(in.position, quantization, out.position);
+        encode_normal(in.normal, out.normal);
+        out.padding = 0;
+    }
+
+    static void encode(const MyGL::Vertex &in, const Quantization &quantization, MyGL::QuantizedTexturedVertex &out)
+    {
+        quantize_position(in.position, quantization, out.position);
+        encode_normal(in.normal, out.normal);
+        out.tex_coords[0] = to_half(in.tex_coords.x);
+        out.tex_coords[1] = to_half(in.tex_coords.y);
+        out.padding = 0;
+    }
+
+    static void quantize_position(const glm::vec3 &position, const Quantization &quantization, GLushort *out)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            float fraction = std::clamp((position[k] - quantization.origin[k]) / quantization.extent, 0.0f, 1.0f);
+            out[k] = static_cast<GLushort>(std::lround(fraction * 65535.0f));
+        }
+    }
+
+    // Octahedral encoding: the normal is projected onto the octahedron |x| + |y| + |z| = 1, whose lower half is
+    // folded over the upper one, and stored as its x and y
+    static void encode_normal(const glm::vec3 &normal, GLshort *out)
+    {
+        float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (sum == 0.0f)
+        {
+            out[0] = out[1] = 0;
+            return;
+        }
+
+        float x = normal.x / sum, y = normal.y / sum;
+        if (normal.z < 0.0f)
+        {
+            float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = folded_x;
+        }
+        out[0] = static_cast<GLshort>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+        out[1] = static_cast<GLshort>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    // IEEE half float, rounded to nearest
+    static GLushort to_half(float value)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        std::uint32_t sign = (bits >> 16) & 0x8000;
+        std::uint32_t float_exponent = (bits >> 23) & 0xff;
+        std::uint32_t mantissa = bits & 0x7fffff;
+
+        if (float_exponent == 0xff) // infinity or NaN
+            return static_cast<GLushort>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+        int exponent = static_cast<int>(float_exponent) - 127 + 15;
+        if (exponent >= 31)
+            return static_cast<GLushort>(sign | 0x7c00);
+        if (exponent <= 0)
+        {
+            // Subnormal, or zero below the smallest one
+            if (exponent < -10)
+                return static_cast<GLushort>(sign);
+            mantissa |= 0x800000;
+            int shift = 14 - exponent;
+            std::uint32_t half = mantissa >> shift;
+            if ((mantissa >> (shift - 1)) & 1)
+                half++;
+            return static_cast<GLushort>(sign | half);
+        }
+
+        // A carry out of the mantissa correctly increments the exponent
+        std::uint32_t half = sign | (std::uint32_t(exponent) << 10) | (mantissa >> 13);
+        if (mantissa & 0x1000)
+            half++;
+        return static_cast<GLushort>(half);
+    }
+
+    template <typename Func> static void parallel_for(size_t count, unsigned num_threads, const Func &func)
+    {
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t num_blocks = std::clamp<size_t>(count / MIN_ITEMS_PER_THREAD, 1, num_threads);
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < num_blocks; ++i)
+            threads.emplace_back(func, i * count / num_blocks, (i + 1) * count / num_blocks);
+        func(0, count / num_blocks);
+        for (auto &thread : threads)
+            thread.join();
+    }
+};
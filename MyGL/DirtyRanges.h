@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace MyGL
+{
+// Element ranges of a buffer modified since its last upload, merged into as few uploads as is worthwhile
+class DirtyRanges
+{
+  public:
+    struct Range
+    {
+        GLuint first;
+        GLuint count;
+    };
+
+    void add(GLuint first, GLuint count)
+    {
+        if (count > 0)
+            ranges.push_back({first, count});
+    }
+
+    bool empty() const
+    {
+        return ranges.empty();
+    }
+
+    void clear()
+    {
+        ranges.clear();
+    }
+
+    // Sorted, non-overlapping ranges covering all added ones. Ranges separated by at most max_gap elements are
+    // merged, uploading the few elements in between being cheaper than another call
+    std::vector<Range> coalesce(GLuint max_gap = 0) const
+    {
+        std::vector<Range> sorted = ranges;
+        std::sort(sorted.begin(), sorted.end(), [](const Range &a, const Range &b) { return a.first < b.first; });
+
+        std::vector<Range> merged;
+        for (const auto &range : sorted)
+        {
+            if (!merged.empty() && range.first <= merged.back().first + merged.back().count + max_gap)
+            {
+                auto &last = merged.back();
+                last.count = std::max(last.first + last.count, range.first + range.count) - last.first;
+            }
+            else
+                merged.push_back(range);
+        }
+        return merged;
+    }
+
+  private:
+    std::vector<Range> ranges;
+};
+} // namespace MyGL
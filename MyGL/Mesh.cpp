@@ -1,12 +1,44 @@
 #include "Mesh.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
 
-MyGL::Mesh::Mesh(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices)
+namespace
+{
+// Dirty ranges closer than this are uploaded together, including the unchanged bytes in between
+constexpr GLuint MAX_GAP_BYTES = 4096;
+
+// Shared by all meshes, so that a revision identifies the contents of one mesh
+GLuint64 last_revision = 0;
+
+std::vector<GLushort> narrow_indices(std::span<const GLuint> indices)
+{
+    return std::vector<GLushort>(indices.begin(), indices.end());
+}
+} // namespace
+
+MyGL::Mesh::Mesh(std::span<const Vertex> vertices, std::span<const GLuint> indices)
 {
     setup(vertices, indices);
 }
 
+MyGL::Mesh::Mesh(VertexFormat format, GLuint num_vertices, GLuint num_indices, const glm::mat4 &position_transform)
+    : format(format), index_type(get_index_type(num_vertices)), position_transform(position_transform)
+{
+    if (num_indices % 3 != 0)
+        throw std::runtime_error("Mesh setup failed: index count must be multiple of 3");
+
+    generate_buffers();
+    this->num_vertices = num_vertices;
+    this->num_indices = num_indices;
+    num_drawn_indices = 0;
+
+    setup_VBO(num_vertices, nullptr);
+    setup_EBO(num_indices, nullptr);
+}
+
 MyGL::Mesh::~Mesh()
 {
     glDeleteVertexArrays(1, &VAO);
@@ -14,32 +46,79 @@ MyGL::Mesh::~Mesh()
     glDeleteBuffers(1, &EBO);
 }
 
+GLsizei MyGL::Mesh::get_vertex_size(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::QUANTIZED:
+        return sizeof(QuantizedVertex);
+    case VertexFormat::QUANTIZED_TEXTURED:
+        return sizeof(QuantizedTexturedVertex);
+    default:
+        return sizeof(Vertex);
+    }
+}
+
+GLenum MyGL::Mesh::get_index_type(GLuint num_vertices)
+{
+    return num_vertices <= std::numeric_limits<GLushort>::max() + 1u ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+GLsizei MyGL::Mesh::get_index_size(GLenum index_type)
+{
+    return index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
 void MyGL::Mesh::draw(DrawMode mode) const
 {
     glBindVertexArray(VAO);
+    glDrawElements(set_draw_mode(mode), num_drawn_indices, index_type, 0);
+    glBindVertexArray(0);
+}
+
+void MyGL::Mesh::draw(DrawMode mode, std::span<const IndexRange> ranges) const
+{
+    // Ranges are clipped to the uploaded indices or to the levels of detail
+    GLsizei index_size = get_index_size(index_type);
+    draw_counts.clear();
+    draw_offsets.clear();
+    for (const auto &range : ranges)
+    {
+        GLuint end = range.first >= num_indices ? num_indices + num_lod_indices : num_drawn_indices;
+        if (range.first >= end)
+            continue;
+        draw_counts.push_back(std::min(range.count, end - range.first));
+        draw_offsets.push_back(reinterpret_cast<const void *>(GLintptr(range.first) * index_size));
+    }
+    if (draw_counts.empty())
+        return;
 
+    glBindVertexArray(VAO);
+    glMultiDrawElements(set_draw_mode(mode), draw_counts.data(), index_type, draw_offsets.data(),
+                        static_cast<GLsizei>(draw_counts.size()));
+    glBindVertexArray(0);
+}
+
+GLenum MyGL::Mesh::set_draw_mode(DrawMode mode) const
+{
     switch (mode)
     {
-    case DrawMode::FILL:
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_INT, 0);
-        break;
     case DrawMode::WIREFRAME:
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glLineWidth(1.0f); // TODO: remove magic number
-        glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_INT, 0);
-        break;
+        glLineWidth(line_width);
+        return GL_TRIANGLES;
     case DrawMode::POINTS:
         glPolygonMode(GL_FRONT_AND_BACK, GL_POINTS);
         glPointSize(15.0f); // TODO: remove magic number
-        glDrawElements(GL_POINTS, num_indices, GL_UNSIGNED_INT, 0);
-        break;
+        return GL_POINTS;
+    case DrawMode::SHADED_WIREFRAME: // the edges come from the program, in the same pass
+    default:
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        return GL_TRIANGLES;
     }
-
-    glBindVertexArray(0);
 }
 
-void MyGL::Mesh::check_mesh_validity(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices)
+void MyGL::Mesh::check_mesh_validity(std::span<const Vertex> vertices, std::span<const GLuint> indices)
 {
     auto max_index_iter = std::max_element(indices.begin(), indices.end());
     if (max_index_iter != indices.end() && *max_index_iter >= vertices.size())
@@ -51,11 +130,26 @@ void MyGL::Mesh::check_mesh_validity(const std::vector<Vertex> &vertices, const
         throw std::runtime_error("Mesh setup failed: index count must be multiple of 3");
 }
 
-void MyGL::Mesh::setup(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices)
+void MyGL::Mesh::setup(std::span<const Vertex> vertices, std::span<const GLuint> indices)
 {
     num_indices = indices.size();
     num_vertices = vertices.size();
+    num_drawn_indices = num_indices;
+    index_type = get_index_type(num_vertices);
+
+    generate_buffers();
+
+    check_mesh_validity(vertices, indices);
+
+    setup_VBO(vertices.size(), vertices.data());
+    if (index_type == GL_UNSIGNED_SHORT)
+        setup_EBO(indices.size(), narrow_indices(indices).data());
+    else
+        setup_EBO(indices.size(), indices.data());
+}
 
+void MyGL::Mesh::generate_buffers()
+{
     glGenVertexArrays(1, &VAO);
     if (VAO == 0)
         throw std::runtime_error("Mesh setup failed: Failed to generate VAO");
@@ -74,78 +168,315 @@ void MyGL::Mesh::setup(const std::vector<Vertex> &vertices, const std::vector<GL
         glDeleteBuffers(1, &VBO);
         throw std::runtime_error("Mesh setup failed: Failed to generate EBO");
     }
-
-    check_mesh_validity(vertices, indices);
-
-    setup_VBO(vertices);
-    setup_EBO(indices);
 }
 
-void MyGL::Mesh::setup_VBO(const std::vector<Vertex> &vertices)
+void MyGL::Mesh::setup_VBO(GLuint count, const void *data)
 {
     glBindVertexArray(VAO);
 
     // Buffer data
+    GLsizei stride = get_vertex_size(format);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_DYNAMIC_DRAW);
-
-    // Location 0: Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
-    // Location 1: Normal
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
-    // Location 2: TexCoords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, tex_coords));
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(count) * stride, data, GL_DYNAMIC_DRAW);
+    revision = ++last_revision;
+
+    switch (format)
+    {
+    case VertexFormat::FLOAT:
+        // Location 0: Position
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+        // Location 1: Normal
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(Vertex, normal));
+        // Location 2: TexCoords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(Vertex, tex_coords));
+        break;
+    case VertexFormat::QUANTIZED:
+    case VertexFormat::QUANTIZED_TEXTURED:
+        // Location 0: Position in [0, 1], scaled by the position transform
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)0);
+        // Location 1: Octahedral normal in [-1, 1], decoded by the shader
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void *)offsetof(QuantizedVertex, normal));
+        // Location 2: TexCoords as half floats, the default (0, 0) without them
+        if (format == VertexFormat::QUANTIZED_TEXTURED)
+        {
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                                  (void *)offsetof(QuantizedTexturedVertex, tex_coords));
+        }
+        else
+            glDisableVertexAttribArray(2);
+        break;
+    }
 
     glBindVertexArray(0);
 }
 
-void MyGL::Mesh::setup_EBO(const std::vector<GLuint> &indices)
+void MyGL::Mesh::setup_EBO(GLuint count, const void *data)
 {
     glBindVertexArray(VAO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(count) * get_index_size(index_type), data, GL_DYNAMIC_DRAW);
     glBindVertexArray(0);
+    revision = ++last_revision;
 }
 
-void MyGL::Mesh::update(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices)
+void MyGL::Mesh::check_vertex_range(GLuint first, GLuint count) const
 {
-    num_vertices = vertices.size();
-    num_indices = indices.size();
+    if (first > num_vertices || count > num_vertices - first)
+        throw std::runtime_error("Mesh update failed: vertex range out of bounds");
+}
+
+void MyGL::Mesh::check_index_range(GLuint first, GLuint count) const
+{
+    if (first > num_indices || count > num_indices - first)
+        throw std::runtime_error("Mesh update failed: index range out of bounds");
+}
+
+void MyGL::Mesh::check_float_format() const
+{
+    if (format != VertexFormat::FLOAT)
+        throw std::runtime_error("Mesh update failed: vertices must be converted to the mesh vertex format");
+}
 
+void MyGL::Mesh::update(std::span<const Vertex> vertices, std::span<const GLuint> indices)
+{
+    check_float_format();
     check_mesh_validity(vertices, indices);
 
-    setup_VBO(vertices);
-    setup_EBO(indices);
+    num_vertices = vertices.size();
+    num_indices = indices.size();
+    num_drawn_indices = num_indices;
+    num_lod_indices = 0; // the levels of detail are dropped with the old buffer
+    index_type = get_index_type(num_vertices);
+
+    setup_VBO(vertices.size(), vertices.data());
+    if (index_type == GL_UNSIGNED_SHORT)
+        setup_EBO(indices.size(), narrow_indices(indices).data());
+    else
+        setup_EBO(indices.size(), indices.data());
 }
 
-void MyGL::Mesh::update_vertices(const std::vector<Vertex> &vertices)
+void MyGL::Mesh::update_vertices(std::span<const Vertex> vertices)
 {
     if (vertices.size() != num_vertices)
         throw std::runtime_error("Mesh update failed: New vertices count must match original count");
 
-    setup_VBO(vertices);
+    // Same size, so the storage and the attribute setup are kept
+    upload_vertices(0, vertices);
 }
 
-void MyGL::Mesh::update_indices(const std::vector<GLuint> &indices)
+void MyGL::Mesh::update_indices(std::span<const GLuint> indices)
 {
     if (indices.size() != num_indices)
         throw std::runtime_error("Mesh update failed: New indices count must match original count");
 
+    upload_indices(0, indices);
+}
+
+void MyGL::Mesh::upload_vertices(GLuint first, std::span<const Vertex> vertices)
+{
+    check_float_format();
+    upload_vertex_data(first, std::as_bytes(vertices));
+}
+
+void MyGL::Mesh::upload_indices(GLuint first, std::span<const GLuint> indices)
+{
+    auto max_index_iter = std::max_element(indices.begin(), indices.end());
+    if (max_index_iter != indices.end() && *max_index_iter >= num_vertices)
+        throw std::runtime_error("Mesh update failed: index out of bounds. Max index: " +
+                                 std::to_string(*max_index_iter) + ", vertex count: " + std::to_string(num_vertices));
+
+    if (index_type == GL_UNSIGNED_SHORT)
+    {
+        auto narrowed = narrow_indices(indices);
+        upload_index_data(first, std::as_bytes(std::span<const GLushort>(narrowed)));
+    }
+    else
+        upload_index_data(first, std::as_bytes(indices));
+}
+
+void MyGL::Mesh::upload_vertex_data(GLuint first, std::span<const std::byte> data)
+{
+    GLsizei vertex_size = get_vertex_size(format);
+    if (data.size() % vertex_size != 0)
+        throw std::runtime_error("Mesh update failed: vertex data size must be multiple of the vertex size");
+    check_vertex_range(first, data.size() / vertex_size);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, GLintptr(first) * vertex_size, data.size(), data.data());
+    revision = ++last_revision;
+}
+
+void MyGL::Mesh::upload_index_data(GLuint first, std::span<const std::byte> data)
+{
+    GLsizei index_size = get_index_size(index_type);
+    if (data.size() % index_size != 0)
+        throw std::runtime_error("Mesh update failed: index data size must be multiple of the index size");
+    GLuint count = data.size() / index_size;
+    check_index_range(first, count);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, GLintptr(first) * index_size, data.size(), data.data());
+    glBindVertexArray(0);
+
+    set_indices_uploaded(first, count);
+}
+
+std::span<std::byte> MyGL::Mesh::map_vertex_data(GLuint first, GLuint count)
+{
+    check_vertex_range(first, count);
+
+    GLsizei vertex_size = get_vertex_size(format);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    auto data = glMapBufferRange(GL_ARRAY_BUFFER, GLintptr(first) * vertex_size, GLsizeiptr(count) * vertex_size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (!data)
+        throw std::runtime_error("Mesh update failed: Failed to map VBO");
+    return std::span<std::byte>(static_cast<std::byte *>(data), size_t(count) * vertex_size);
+}
+
+std::span<std::byte> MyGL::Mesh::map_index_data(GLuint first, GLuint count)
+{
+    check_index_range(first, count);
+
+    // The element buffer binding is part of the VAO state
+    GLsizei index_size = get_index_size(index_type);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    auto data = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, GLintptr(first) * index_size, GLsizeiptr(count) * index_size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    glBindVertexArray(0);
+    if (!data)
+        throw std::runtime_error("Mesh update failed: Failed to map EBO");
+
+    mapped_first_index = first;
+    mapped_index_count = count;
+    return std::span<std::byte>(static_cast<std::byte *>(data), size_t(count) * index_size);
+}
+
+void MyGL::Mesh::unmap_vertices()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    revision = ++last_revision;
+    if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)
+        throw std::runtime_error("Mesh update failed: VBO contents were lost while mapped");
+}
+
+void MyGL::Mesh::unmap_indices()
+{
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    auto is_intact = glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    glBindVertexArray(0);
+    if (is_intact == GL_FALSE)
+        throw std::runtime_error("Mesh update failed: EBO contents were lost while mapped");
+
+    set_indices_uploaded(mapped_first_index, mapped_index_count);
+    mapped_index_count = 0;
+}
+
+GLuint MyGL::Mesh::append_lod_indices(std::span<const GLuint> indices)
+{
     auto max_index_iter = std::max_element(indices.begin(), indices.end());
     if (max_index_iter != indices.end() && *max_index_iter >= num_vertices)
         throw std::runtime_error("Mesh update failed: index out of bounds. Max index: " +
                                  std::to_string(*max_index_iter) + ", vertex count: " + std::to_string(num_vertices));
 
-    setup_EBO(indices);
+    if (index_type == GL_UNSIGNED_SHORT)
+    {
+        auto narrowed = narrow_indices(indices);
+        return append_lod_index_data(std::as_bytes(std::span<const GLushort>(narrowed)));
+    }
+    return append_lod_index_data(std::as_bytes(indices));
+}
+
+GLuint MyGL::Mesh::append_lod_index_data(std::span<const std::byte> data)
+{
+    GLsizei index_size = get_index_size(index_type);
+    if (data.size() % (3 * index_size) != 0)
+        throw std::runtime_error("Mesh update failed: index data size must be multiple of the triangle size");
+
+    // The buffer is reallocated with room for the new indices and the previous contents copied on the GPU
+    GLuint first = num_indices + num_lod_indices;
+    GLuint new_EBO;
+    glGenBuffers(1, &new_EBO);
+    if (new_EBO == 0)
+        throw std::runtime_error("Mesh update failed: Failed to generate EBO");
+
+    glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(first) * index_size + data.size(), nullptr, GL_DYNAMIC_DRAW);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GLsizeiptr(first) * index_size);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(first) * index_size, data.size(), data.data());
+
+    glDeleteBuffers(1, &EBO);
+    EBO = new_EBO;
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindVertexArray(0);
+
+    num_lod_indices += data.size() / index_size;
+    revision = ++last_revision;
+    return first;
+}
+
+void MyGL::Mesh::set_indices_uploaded(GLuint first, GLuint count)
+{
+    revision = ++last_revision;
+
+    // Only a contiguous prefix is tracked, a range past a gap is not drawn
+    if (first <= num_drawn_indices)
+        num_drawn_indices = std::max(num_drawn_indices, first + count);
+}
+
+void MyGL::Mesh::mark_vertices_dirty(GLuint first, GLuint count)
+{
+    check_vertex_range(first, count);
+    dirty_vertices.add(first, count);
+}
+
+void MyGL::Mesh::mark_indices_dirty(GLuint first, GLuint count)
+{
+    check_index_range(first, count);
+    dirty_indices.add(first, count);
+}
+
+void MyGL::Mesh::flush(std::span<const std::byte> vertex_data, std::span<const GLuint> indices)
+{
+    if (dirty_vertices.empty() && dirty_indices.empty())
+        return;
+    GLsizei vertex_size = get_vertex_size(format);
+    if (vertex_data.size() != size_t(num_vertices) * vertex_size || indices.size() != num_indices)
+        throw std::runtime_error("Mesh update failed: client buffers must match the mesh size");
+
+    for (const auto &range : dirty_vertices.coalesce(MAX_GAP_BYTES / vertex_size))
+        upload_vertex_data(range.first,
+                           vertex_data.subspan(size_t(range.first) * vertex_size, size_t(range.count) * vertex_size));
+    for (const auto &range : dirty_indices.coalesce(MAX_GAP_BYTES / get_index_size(index_type)))
+        upload_indices(range.first, indices.subspan(range.first, range.count));
+
+    dirty_vertices.clear();
+    dirty_indices.clear();
 }
 
 glm::vec3 MyGL::Mesh::get_vertex_position(GLuint index) const
 {
-    glm::vec3 position;
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glGetBufferSubData(GL_ARRAY_BUFFER, index * sizeof(Vertex), sizeof(glm::vec3), &position);
-    return position;
+    if (format == VertexFormat::FLOAT)
+    {
+        glm::vec3 position;
+        glGetBufferSubData(GL_ARRAY_BUFFER, GLintptr(index) * sizeof(Vertex), sizeof(glm::vec3), &position);
+        return position;
+    }
+
+    GLushort quantized[3];
+    glGetBufferSubData(GL_ARRAY_BUFFER, GLintptr(index) * get_vertex_size(format), sizeof(quantized), quantized);
+    glm::vec4 position(quantized[0] / 65535.0f, quantized[1] / 65535.0f, quantized[2] / 65535.0f, 1.0f);
+    return glm::vec3(position_transform * position);
 }
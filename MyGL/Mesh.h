@@ -1,13 +1,27 @@
 #pragma once
 
+#include <cstddef>
+#include <span>
 #include <string>
 #include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "DirtyRanges.h"
+
 namespace MyGL
 {
+// Layouts of the vertex buffer. The quantized ones store positions as 16-bit fractions of a cube around the mesh,
+// decoded by the position transform of the mesh, normals octahedral-encoded in two 16-bit components and
+// texture coordinates as half floats
+enum class VertexFormat
+{
+    FLOAT,
+    QUANTIZED,
+    QUANTIZED_TEXTURED
+};
+
 struct Vertex
 {
     glm::vec3 position;
@@ -15,10 +29,30 @@ struct Vertex
     glm::vec2 tex_coords;
 };
 
+struct QuantizedVertex
+{
+    GLushort position[3];
+    GLshort normal[2];
+    GLushort padding; // keeps attributes 4-byte aligned
+};
+
+struct QuantizedTexturedVertex
+{
+    GLushort position[3];
+    GLshort normal[2];
+    GLushort tex_coords[2];
+    GLushort padding;
+};
+
 class Mesh
 {
   public:
-    Mesh(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices);
+    Mesh(std::span<const Vertex> vertices, std::span<const GLuint> indices);
+
+    // Allocates the buffers without data, for geometry uploaded in parts. The position transform maps the stored
+    // positions to model space, it is applied by multiplying the model matrix with it
+    Mesh(VertexFormat format, GLuint num_vertices, GLuint num_indices,
+         const glm::mat4 &position_transform = glm::mat4(1.0f));
 
     ~Mesh();
 
@@ -27,7 +61,12 @@ class Mesh
 
     Mesh(Mesh &&other) noexcept
         : VAO(other.VAO), VBO(other.VBO), EBO(other.EBO), num_indices(other.num_indices),
-          num_vertices(other.num_vertices)
+          num_vertices(other.num_vertices), num_drawn_indices(other.num_drawn_indices),
+          num_lod_indices(other.num_lod_indices), revision(other.revision), format(other.format),
+          index_type(other.index_type), position_transform(other.position_transform), line_width(other.line_width),
+          mapped_first_index(other.mapped_first_index),
+          mapped_index_count(other.mapped_index_count),
+          dirty_vertices(std::move(other.dirty_vertices)), dirty_indices(std::move(other.dirty_indices))
     {
         other.VAO = other.VBO = other.EBO = 0;
     }
@@ -44,6 +83,17 @@ class Mesh
             EBO = other.EBO;
             num_indices = other.num_indices;
             num_vertices = other.num_vertices;
+            num_drawn_indices = other.num_drawn_indices;
+            num_lod_indices = other.num_lod_indices;
+            revision = other.revision;
+            format = other.format;
+            index_type = other.index_type;
+            position_transform = other.position_transform;
+            line_width = other.line_width;
+            mapped_first_index = other.mapped_first_index;
+            mapped_index_count = other.mapped_index_count;
+            dirty_vertices = std::move(other.dirty_vertices);
+            dirty_indices = std::move(other.dirty_indices);
 
             other.VAO = 0;
             other.VBO = 0;
@@ -52,29 +102,129 @@ class Mesh
         return *this;
     }
 
-    void update(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices);
-    void update_vertices(const std::vector<Vertex> &vertices);
-    void update_indices(const std::vector<GLuint> &indices);
+    static GLsizei get_vertex_size(VertexFormat format);
+
+    // 16-bit indices whenever they can address all vertices
+    static GLenum get_index_type(GLuint num_vertices);
+    static GLsizei get_index_size(GLenum index_type);
+
+    VertexFormat get_vertex_format() const
+    {
+        return format;
+    }
+    GLenum get_index_type() const
+    {
+        return index_type;
+    }
+    const glm::mat4 &get_position_transform() const
+    {
+        return position_transform;
+    }
+    GLuint get_num_vertices() const
+    {
+        return num_vertices;
+    }
+
+    // Changes whenever the contents of the buffers do, unique among all meshes, e.g. to tell when a rendering of the
+    // mesh kept from an earlier frame is outdated
+    GLuint64 get_revision() const
+    {
+        return revision;
+    }
+
+    // The Vertex overloads require the float format, indices are narrowed to 16 bits if the buffer uses them
+    void update(std::span<const Vertex> vertices, std::span<const GLuint> indices);
+    void update_vertices(std::span<const Vertex> vertices);
+    void update_indices(std::span<const GLuint> indices);
+
+    // Write a range of the buffers in place. Indices are drawn up to the end of the uploaded prefix,
+    // so index ranges are uploaded in order
+    void upload_vertices(GLuint first, std::span<const Vertex> vertices);
+    void upload_indices(GLuint first, std::span<const GLuint> indices);
+
+    // Same for data already in the vertex format and index type of the buffers
+    void upload_vertex_data(GLuint first, std::span<const std::byte> data);
+    void upload_index_data(GLuint first, std::span<const std::byte> data);
+
+    // Map a range of the buffers for writing in their vertex format and index type, its previous contents are
+    // discarded. The memory may be filled from any thread, but no other call may be made on the mesh until the
+    // range is unmapped
+    std::span<std::byte> map_vertex_data(GLuint first, GLuint count);
+    std::span<std::byte> map_index_data(GLuint first, GLuint count);
+    void unmap_vertices();
+    void unmap_indices(); // the indices are not checked against the vertex count
+
+    // Append coarser levels of detail over the same vertices to the index buffer, after the indices of the mesh
+    // itself, which stay the ones drawn by draw(mode), updated and mapped. Returns the position of the first appended
+    // index, for drawing them as ranges
+    GLuint append_lod_indices(std::span<const GLuint> indices);
+    GLuint append_lod_index_data(std::span<const std::byte> data);
+
+    // Record ranges modified in the client copies of the buffers, e.g. by a mesh edit. flush uploads them once per
+    // frame with glBufferSubData, adjacent and nearby ranges coalesced, instead of re-specifying whole buffers.
+    // The client vertices are in the vertex format of the mesh, e.g. converted by MeshToGL::convert_vertices
+    void mark_vertices_dirty(GLuint first, GLuint count);
+    void mark_indices_dirty(GLuint first, GLuint count);
+    void flush(std::span<const std::byte> vertex_data, std::span<const GLuint> indices);
 
     enum class DrawMode
     {
         FILL,
         WIREFRAME,
-        POINTS
+        POINTS,
+        SHADED_WIREFRAME // filled, for a program that draws the edges over the surface, e.g. with wireframe.geom
     };
 
+    // In pixels, of the lines of WIREFRAME and of the edges drawn by the program in SHADED_WIREFRAME
+    float get_line_width() const
+    {
+        return line_width;
+    }
+    void set_line_width(float width)
+    {
+        line_width = width;
+    }
+
     void draw(DrawMode mode = DrawMode::FILL) const;
 
+    struct IndexRange
+    {
+        GLuint first;
+        GLuint count;
+    };
+
+    // Draws only the given index ranges, e.g. the visible clusters or a level of detail, with one glMultiDrawElements
+    // call
+    void draw(DrawMode mode, std::span<const IndexRange> ranges) const;
+
+    // In model space, whatever the vertex format
     glm::vec3 get_vertex_position(GLuint index) const;
 
   private:
     GLuint VAO, VBO, EBO;
     GLuint num_indices, num_vertices;
-
-    static void check_mesh_validity(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices);
-
-    void setup(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices);
-    void setup_VBO(const std::vector<Vertex> &vertices);
-    void setup_EBO(const std::vector<GLuint> &indices);
+    GLuint num_drawn_indices; // uploaded prefix of the indices
+    GLuint num_lod_indices = 0; // appended after them
+    GLuint64 revision = 0;
+    VertexFormat format = VertexFormat::FLOAT;
+    GLenum index_type = GL_UNSIGNED_INT;
+    glm::mat4 position_transform{1.0f};
+    float line_width = 1.0f;
+    GLuint mapped_first_index = 0, mapped_index_count = 0;
+    DirtyRanges dirty_vertices, dirty_indices;
+    mutable std::vector<GLsizei> draw_counts; // arguments of glMultiDrawElements, kept to avoid allocations
+    mutable std::vector<const void *> draw_offsets;
+
+    static void check_mesh_validity(std::span<const Vertex> vertices, std::span<const GLuint> indices);
+
+    void setup(std::span<const Vertex> vertices, std::span<const GLuint> indices);
+    void generate_buffers();
+    void check_vertex_range(GLuint first, GLuint count) const;
+    void check_index_range(GLuint first, GLuint count) const;
+    void check_float_format() const;
+    void set_indices_uploaded(GLuint first, GLuint count);
+    GLenum set_draw_mode(DrawMode mode) const; // returns the primitive to draw
+    void setup_VBO(GLuint count, const void *data); // data may be null to only allocate
+    void setup_EBO(GLuint count, const void *data);
 };
-} // namespace MyGL
\ No newline at end of file
+} // namespace MyGL
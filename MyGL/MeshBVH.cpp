@@ -0,0 +1,355 @@
+#include "MeshBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <utility>
+
+namespace
+{
+float half_area(const glm::vec3 &min, const glm::vec3 &max)
+{
+    auto extent = max - min;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+void grow(glm::vec3 &min, glm::vec3 &max, const glm::vec3 &point_min, const glm::vec3 &point_max)
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        min[k] = std::min(min[k], point_min[k]);
+        max[k] = std::max(max[k], point_max[k]);
+    }
+}
+
+// Distance along the ray to the box, infinity if it misses it before max_distance
+float intersect_box(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &origin,
+                    const glm::vec3 &inverse_direction, float max_distance)
+{
+    float near = 0.0f, far = max_distance;
+    for (int k = 0; k < 3; ++k)
+    {
+        float t0 = (min[k] - origin[k]) * inverse_direction[k];
+        float t1 = (max[k] - origin[k]) * inverse_direction[k];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        near = std::max(near, t0);
+        far = std::min(far, t1);
+    }
+    return near <= far ? near : std::numeric_limits<float>::infinity();
+}
+
+// Möller-Trumbore, both sides of the triangle
+std::optional<float> intersect_triangle(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a,
+                                        const glm::vec3 &b, const glm::vec3 &c)
+{
+    auto ab = b - a, ac = c - a;
+    auto p = glm::cross(direction, ac);
+    float determinant = glm::dot(ab, p);
+    if (determinant == 0.0f)
+        return std::nullopt;
+
+    float inverse_determinant = 1.0f / determinant;
+    auto ao = origin - a;
+    float u = glm::dot(ao, p) * inverse_determinant;
+    if (u < 0.0f || u > 1.0f)
+        return std::nullopt;
+    auto q = glm::cross(ao, ab);
+    float v = glm::dot(direction, q) * inverse_determinant;
+    if (v < 0.0f || u + v > 1.0f)
+        return std::nullopt;
+    return glm::dot(ac, q) * inverse_determinant;
+}
+
+bool is_outside(std::span<const glm::vec4> planes, const glm::vec3 &min, const glm::vec3 &max)
+{
+    // The box is outside a plane if its corner farthest along the plane normal is
+    for (const auto &plane : planes)
+    {
+        glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y,
+                         plane.z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            return true;
+    }
+    return false;
+}
+
+bool is_contained(std::span<const glm::vec4> planes, const glm::vec3 &min, const glm::vec3 &max)
+{
+    // Same with the corner nearest along the normal
+    for (const auto &plane : planes)
+    {
+        glm::vec3 corner(plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y,
+                         plane.z >= 0.0f ? min.z : max.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+} // namespace
+
+MyGL::MeshBVH::MeshBVH(std::span<const glm::vec3> positions, std::span<const GLuint> indices, unsigned num_threads)
+    : positions(positions.begin(), positions.end())
+{
+    GLuint n_triangles = static_cast<GLuint>(indices.size() / 3);
+    if (n_triangles == 0)
+        return;
+
+    std::vector<Bounds> triangle_bounds(n_triangles);
+    std::vector<glm::vec3> centroids(n_triangles);
+    std::vector<GLuint> order(n_triangles);
+    for (GLuint t = 0; t < n_triangles; ++t)
+    {
+        const auto &a = positions[indices[3 * t]];
+        const auto &b = positions[indices[3 * t + 1]];
+        const auto &c = positions[indices[3 * t + 2]];
+        triangle_bounds[t] = {a, a};
+        grow(triangle_bounds[t].min, triangle_bounds[t].max, b, b);
+        grow(triangle_bounds[t].min, triangle_bounds[t].max, c, c);
+        centroids[t] = (triangle_bounds[t].min + triangle_bounds[t].max) * 0.5f;
+        order[t] = t;
+    }
+
+    // One subtree per thread
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned parallel_depth = 0;
+    while ((1u << parallel_depth) < num_threads)
+        parallel_depth++;
+
+    nodes.reserve(2 * n_triangles / MAX_LEAF_SIZE + 1);
+    build(nodes, order, triangle_bounds, centroids, 0, n_triangles, parallel_depth);
+
+    this->indices.resize(3 * size_t(n_triangles));
+    for (GLuint t = 0; t < n_triangles; ++t)
+        std::copy_n(indices.begin() + 3 * size_t(order[t]), 3, this->indices.begin() + 3 * size_t(t));
+
+    // Each vertex is tested by its first reference only
+    std::vector<bool> is_referenced(positions.size(), false);
+    first_references.resize(this->indices.size());
+    for (size_t i = 0; i < this->indices.size(); ++i)
+    {
+        first_references[i] = !is_referenced[this->indices[i]];
+        is_referenced[this->indices[i]] = true;
+    }
+}
+
+void MyGL::MeshBVH::build(std::vector<Node> &nodes, std::span<GLuint> order, std::span<const Bounds> triangle_bounds,
+                          std::span<const glm::vec3> centroids, GLuint first, GLuint count, unsigned parallel_depth)
+{
+    Node node;
+    node.min = glm::vec3(std::numeric_limits<float>::max());
+    node.max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (GLuint i = first; i < first + count; ++i)
+        grow(node.min, node.max, triangle_bounds[order[i]].min, triangle_bounds[order[i]].max);
+    node.first = first;
+    node.count = count;
+
+    GLuint index = static_cast<GLuint>(nodes.size());
+    nodes.push_back(node);
+
+    GLuint left_count = split(order, triangle_bounds, centroids, node);
+    if (left_count == 0)
+        return;
+
+    GLuint right_child;
+    if (parallel_depth > 0 && count >= MIN_PARALLEL_TRIANGLES)
+    {
+        // The subtrees partition disjoint ranges of the order, each into its own nodes, appended afterwards
+        std::vector<Node> left_nodes, right_nodes;
+        std::thread thread(
+            [&] { build(left_nodes, order, triangle_bounds, centroids, first, left_count, parallel_depth - 1); });
+        build(right_nodes, order, triangle_bounds, centroids, first + left_count, count - left_count,
+              parallel_depth - 1);
+        thread.join();
+
+        auto append = [&nodes](const std::vector<Node> &subtree) {
+            auto offset = static_cast<GLuint>(nodes.size());
+            for (auto subtree_node : subtree)
+            {
+                if (subtree_node.count == 0)
+                    subtree_node.first += offset;
+                nodes.push_back(subtree_node);
+            }
+        };
+        append(left_nodes);
+        right_child = static_cast<GLuint>(nodes.size());
+        append(right_nodes);
+    }
+    else
+    {
+        build(nodes, order, triangle_bounds, centroids, first, left_count, 0);
+        right_child = static_cast<GLuint>(nodes.size());
+        build(nodes, order, triangle_bounds, centroids, first + left_count, count - left_count, 0);
+    }
+
+    nodes[index].first = right_child;
+    nodes[index].count = 0;
+}
+
+GLuint MyGL::MeshBVH::split(std::span<GLuint> order, std::span<const Bounds> triangle_bounds,
+                            std::span<const glm::vec3> centroids, const Node &node)
+{
+    GLuint first = node.first, count = node.count;
+    if (count <= 1)
+        return 0;
+
+    // Binned along the longest extent of the centroids
+    glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+    for (GLuint i = first; i < first + count; ++i)
+        grow(min, max, centroids[order[i]], centroids[order[i]]);
+    auto extent = max - min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    auto begin = order.begin() + first, end = begin + count;
+    if (extent[axis] == 0.0f)
+    {
+        // Identical centroids cannot be told apart, large groups of them are halved
+        return count <= MAX_LEAF_SIZE ? 0 : count / 2;
+    }
+
+    struct Bin
+    {
+        glm::vec3 min{std::numeric_limits<float>::max()}, max{std::numeric_limits<float>::lowest()};
+        GLuint count = 0;
+    } bins[SAH_BINS];
+    float scale = SAH_BINS / extent[axis];
+    auto bin_of = [&](GLuint t) {
+        return std::min(SAH_BINS - 1, static_cast<GLuint>((centroids[t][axis] - min[axis]) * scale));
+    };
+    for (auto it = begin; it != end; ++it)
+    {
+        auto &bin = bins[bin_of(*it)];
+        grow(bin.min, bin.max, triangle_bounds[*it].min, triangle_bounds[*it].max);
+        bin.count++;
+    }
+
+    // Cost of each split between bins, proportional to the expected number of triangle tests
+    float right_costs[SAH_BINS];
+    {
+        glm::vec3 right_min(std::numeric_limits<float>::max()), right_max(std::numeric_limits<float>::lowest());
+        GLuint right_count = 0;
+        for (GLuint b = SAH_BINS - 1; b > 0; --b)
+        {
+            grow(right_min, right_max, bins[b].min, bins[b].max);
+            right_count += bins[b].count;
+            right_costs[b] = right_count ? half_area(right_min, right_max) * right_count : 0.0f;
+        }
+    }
+    glm::vec3 left_min(std::numeric_limits<float>::max()), left_max(std::numeric_limits<float>::lowest());
+    GLuint left_count = 0;
+    float best_cost = std::numeric_limits<float>::max();
+    GLuint best_bin = 0;
+    for (GLuint b = 0; b + 1 < SAH_BINS; ++b)
+    {
+        grow(left_min, left_max, bins[b].min, bins[b].max);
+        left_count += bins[b].count;
+        float cost = (left_count ? half_area(left_min, left_max) * left_count : 0.0f) + right_costs[b + 1];
+        if (left_count > 0 && left_count < count && cost < best_cost)
+        {
+            best_cost = cost;
+            best_bin = b;
+        }
+    }
+
+    // A leaf is kept if splitting it does not pay off
+    if (count <= MAX_LEAF_SIZE && best_cost >= half_area(node.min, node.max) * count)
+        return 0;
+
+    auto middle = std::partition(begin, end, [&](GLuint t) { return bin_of(t) <= best_bin; });
+    return static_cast<GLuint>(middle - begin);
+}
+
+std::optional<float> MyGL::MeshBVH::intersect(const glm::vec3 &origin, const glm::vec3 &direction,
+                                               float max_distance) const
+{
+    if (nodes.empty())
+        return std::nullopt;
+
+    glm::vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float nearest = max_distance;
+    bool is_hit = false;
+
+    // Nearer child first, nodes beyond the nearest hit so far are skipped
+    std::vector<GLuint> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const auto &node = nodes[stack.back()];
+        stack.pop_back();
+        if (intersect_box(node.min, node.max, origin, inverse_direction, nearest) > nearest)
+            continue;
+
+        if (node.count > 0)
+        {
+            for (GLuint t = node.first; t < node.first + node.count; ++t)
+            {
+                auto distance = intersect_triangle(origin, direction, positions[indices[3 * t]],
+                                                   positions[indices[3 * t + 1]], positions[indices[3 * t + 2]]);
+                if (distance && *distance >= 0.0f && *distance <= nearest)
+                {
+                    nearest = *distance;
+                    is_hit = true;
+                }
+            }
+            continue;
+        }
+
+        GLuint left = static_cast<GLuint>(&node - nodes.data()) + 1, right = node.first;
+        float left_distance = intersect_box(nodes[left].min, nodes[left].max, origin, inverse_direction, nearest);
+        float right_distance = intersect_box(nodes[right].min, nodes[right].max, origin, inverse_direction, nearest);
+        if (left_distance < right_distance)
+        {
+            std::swap(left, right);
+            std::swap(left_distance, right_distance);
+        }
+        if (left_distance <= nearest)
+            stack.push_back(left);
+        if (right_distance <= nearest)
+            stack.push_back(right);
+    }
+
+    if (!is_hit)
+        return std::nullopt;
+    return nearest;
+}
+
+void MyGL::MeshBVH::find_vertices(std::span<const glm::vec4> planes, std::vector<GLuint> &vertices) const
+{
+    if (nodes.empty())
+        return;
+
+    // Subtrees inside all planes are collected without further tests
+    std::vector<std::pair<GLuint, bool>> stack;
+    stack.reserve(64);
+    stack.emplace_back(0, false);
+    while (!stack.empty())
+    {
+        auto [index, is_inside] = stack.back();
+        const auto &node = nodes[index];
+        stack.pop_back();
+        if (!is_inside)
+        {
+            if (is_outside(planes, node.min, node.max))
+                continue;
+            is_inside = is_contained(planes, node.min, node.max);
+        }
+
+        if (node.count > 0)
+        {
+            // A vertex inside the region is inside the bounds of all its triangles, so the leaf of its first
+            // reference is never skipped
+            for (size_t i = 3 * size_t(node.first); i < 3 * size_t(node.first + node.count); ++i)
+            {
+                const auto &position = positions[indices[i]];
+                if (first_references[i] && (is_inside || !is_outside(planes, position, position)))
+                    vertices.push_back(indices[i]);
+            }
+            continue;
+        }
+        stack.emplace_back(node.first, is_inside);
+        stack.emplace_back(index + 1, is_inside);
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace MyGL
+{
+// Bounding volume hierarchy over the triangles of a mesh, for picking on the CPU: ray casts against the surface and
+// queries for the vertices inside a convex region, such as the frustum around a pixel. Built with the surface area
+// heuristic, the top levels split over several threads.
+class MeshBVH
+{
+  public:
+    MeshBVH() = default;
+
+    // From the positions and indices of the GL buffers, in model space. 0 threads uses all hardware threads
+    MeshBVH(std::span<const glm::vec3> positions, std::span<const GLuint> indices, unsigned num_threads = 0);
+
+    bool empty() const
+    {
+        return nodes.empty();
+    }
+
+    size_t get_num_vertices() const
+    {
+        return positions.size();
+    }
+
+    const glm::vec3 &get_position(GLuint vertex) const
+    {
+        return positions[vertex];
+    }
+
+    // Nearest intersection of the ray with the triangles, front or back, as the multiple of the direction from the
+    // origin, up to max_distance
+    std::optional<float> intersect(const glm::vec3 &origin, const glm::vec3 &direction, float max_distance) const;
+
+    // Appends the vertices of the triangles that are on the positive side of all planes, (a, b, c, d) meaning
+    // a x + b y + c z + d >= 0, each once
+    void find_vertices(std::span<const glm::vec4> planes, std::vector<GLuint> &vertices) const;
+
+  private:
+    // Nodes in depth-first order, the left child follows its parent
+    struct Node
+    {
+        glm::vec3 min;
+        GLuint first; // first triangle of a leaf, right child of an inner node
+        glm::vec3 max;
+        GLuint count; // triangles of a leaf, 0 for inner nodes
+    };
+
+    struct Bounds
+    {
+        glm::vec3 min, max;
+    };
+
+    static constexpr GLuint MAX_LEAF_SIZE = 4;
+    static constexpr GLuint SAH_BINS = 16;
+    static constexpr GLuint MIN_PARALLEL_TRIANGLES = 1u << 15; // smaller subtrees are built on the current thread
+
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint> indices;          // in leaf order
+    std::vector<GLubyte> first_references; // whether each index is the first one of its vertex
+    std::vector<Node> nodes;
+
+    // Builds the subtree of the triangles in order[first, first + count) into nodes, child indices being positions in
+    // that vector. The top parallel_depth levels build their left subtree on a new thread, into a separate vector
+    static void build(std::vector<Node> &nodes, std::span<GLuint> order, std::span<const Bounds> triangle_bounds,
+                      std::span<const glm::vec3> centroids, GLuint first, GLuint count, unsigned parallel_depth);
+
+    // Reorders the triangles of a node that is still a leaf over them, returns the number going to the left child or
+    // 0 to keep the leaf
+    static GLuint split(std::span<GLuint> order, std::span<const Bounds> triangle_bounds,
+                        std::span<const glm::vec3> centroids, const Node &node);
+};
+} // namespace MyGL
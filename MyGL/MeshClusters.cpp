@@ -0,0 +1,212 @@
+#include "MeshClusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// Sphere around a set of points or spheres: the center of their bounding box and the farthest extent from it
+template <typename Func> void bounding_sphere(size_t count, const Func &sphere_of, glm::vec3 &center, float &radius)
+{
+    glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto [c, r] = sphere_of(i);
+        for (int k = 0; k < 3; ++k)
+        {
+            min[k] = std::min(min[k], c[k] - r);
+            max[k] = std::max(max[k], c[k] + r);
+        }
+    }
+    center = (min + max) * 0.5f;
+
+    radius = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto [c, r] = sphere_of(i);
+        radius = std::max(radius, glm::length(c - center) + r);
+    }
+}
+
+enum class Containment
+{
+    OUTSIDE,
+    INTERSECTING,
+    INSIDE
+};
+
+Containment classify(const glm::vec4 (&planes)[6], const glm::vec3 &center, float radius)
+{
+    auto result = Containment::INSIDE;
+    for (const auto &plane : planes)
+    {
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        if (distance < -radius)
+            return Containment::OUTSIDE;
+        if (distance < radius)
+            result = Containment::INTERSECTING;
+    }
+    return result;
+}
+} // namespace
+
+MyGL::MeshClusters::MeshClusters(std::span<const glm::vec3> positions, std::span<const GLuint> indices)
+{
+    GLuint n_triangles = static_cast<GLuint>(indices.size() / 3);
+    clusters.reserve((n_triangles + CLUSTER_TRIANGLES - 1) / CLUSTER_TRIANGLES);
+
+    std::vector<glm::vec3> normals;
+    for (GLuint first_triangle = 0; first_triangle < n_triangles; first_triangle += CLUSTER_TRIANGLES)
+    {
+        Cluster cluster;
+        cluster.first_index = 3 * first_triangle;
+        cluster.index_count = 3 * std::min(CLUSTER_TRIANGLES, n_triangles - first_triangle);
+        auto cluster_indices = indices.subspan(cluster.first_index, cluster.index_count);
+
+        bounding_sphere(
+            cluster_indices.size(),
+            [&](size_t i) { return std::pair(positions[cluster_indices[i]], 0.0f); }, cluster.center,
+            cluster.radius);
+
+        // The axis is the mean of the unit normals, the cone opens up to the normal farthest from it
+        normals.clear();
+        glm::vec3 axis(0.0f);
+        for (size_t i = 0; i < cluster_indices.size(); i += 3)
+        {
+            const auto &a = positions[cluster_indices[i]];
+            auto normal = glm::cross(positions[cluster_indices[i + 1]] - a, positions[cluster_indices[i + 2]] - a);
+            float length = glm::length(normal);
+            if (length > 0.0f) // degenerate triangles face nowhere
+            {
+                normals.push_back(normal / length);
+                axis += normals.back();
+            }
+        }
+
+        float axis_length = glm::length(axis);
+        cluster.cone_axis = axis_length > 0.0f ? axis / axis_length : glm::vec3(0.0f, 0.0f, 1.0f);
+        float min_cosine = axis_length > 0.0f ? 1.0f : -1.0f;
+        for (const auto &normal : normals)
+            min_cosine = std::min(min_cosine, glm::dot(normal, cluster.cone_axis));
+        cluster.cone_cutoff = min_cosine > 0.0f ? std::sqrt(1.0f - min_cosine * min_cosine) : 2.0f;
+
+        clusters.push_back(cluster);
+    }
+
+    if (!clusters.empty())
+        build_node(0, static_cast<GLuint>(clusters.size()));
+}
+
+GLuint MyGL::MeshClusters::build_node(GLuint first, GLuint count)
+{
+    GLuint index = static_cast<GLuint>(nodes.size());
+    nodes.push_back({});
+
+    Node node;
+    node.first_cluster = first;
+    node.cluster_count = count;
+    node.right_child = 0;
+    bounding_sphere(
+        count, [&](size_t i) { return std::pair(clusters[first + i].center, clusters[first + i].radius); },
+        node.center, node.radius);
+
+    if (count > LEAF_SIZE)
+    {
+        // Median split of the cluster centers along their longest extent
+        glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+        for (GLuint i = first; i < first + count; ++i)
+            for (int k = 0; k < 3; ++k)
+            {
+                min[k] = std::min(min[k], clusters[i].center[k]);
+                max[k] = std::max(max[k], clusters[i].center[k]);
+            }
+        auto extent = max - min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        GLuint half = count / 2;
+        std::nth_element(clusters.begin() + first, clusters.begin() + first + half, clusters.begin() + first + count,
+                         [axis](const Cluster &a, const Cluster &b) { return a.center[axis] < b.center[axis]; });
+
+        build_node(first, half);
+        node.right_child = build_node(first + half, count - half);
+    }
+
+    nodes[index] = node;
+    return index;
+}
+
+std::span<const MyGL::Mesh::IndexRange> MyGL::MeshClusters::cull(const glm::mat4 &model, const glm::mat4 &view,
+                                                                   const glm::mat4 &projection, bool cull_backfaces)
+{
+    visible.clear();
+    ranges.clear();
+    visible_count = 0;
+    if (nodes.empty())
+        return ranges;
+
+    // Frustum planes in model space, from the rows of the model-view-projection matrix, pointing inwards
+    glm::mat4 mvp = projection * view * model;
+    auto row = [&mvp](int i) { return glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]); };
+    glm::vec4 planes[6] = {row(3) + row(0), row(3) - row(0), row(3) + row(1),
+                           row(3) - row(1), row(3) + row(2), row(3) - row(2)};
+    for (auto &plane : planes)
+        plane = plane / glm::length(glm::vec3(plane));
+
+    glm::vec3 camera_position = glm::vec3(glm::inverse(view * model)[3]);
+
+    // A cluster faces away if every direction from the camera into its sphere is within 90 degrees of every
+    // normal of its cone
+    auto is_backfacing = [&](const Cluster &cluster) {
+        auto direction = cluster.center - camera_position;
+        return glm::dot(direction, cluster.cone_axis) >=
+               glm::length(direction) * cluster.cone_cutoff + cluster.radius;
+    };
+    auto add = [&](GLuint c) {
+        if (!cull_backfaces || !is_backfacing(clusters[c]))
+            visible.push_back(c);
+    };
+
+    stack.assign(1, 0);
+    while (!stack.empty())
+    {
+        const auto &node = nodes[stack.back()];
+        stack.pop_back();
+
+        auto containment = classify(planes, node.center, node.radius);
+        if (containment == Containment::OUTSIDE)
+            continue;
+
+        // Inside the frustum, the whole subtree is visible
+        if (containment == Containment::INSIDE)
+        {
+            for (GLuint c = node.first_cluster; c < node.first_cluster + node.cluster_count; ++c)
+                add(c);
+        }
+        else if (node.right_child == 0)
+        {
+            for (GLuint c = node.first_cluster; c < node.first_cluster + node.cluster_count; ++c)
+                if (classify(planes, clusters[c].center, clusters[c].radius) != Containment::OUTSIDE)
+                    add(c);
+        }
+        else
+        {
+            stack.push_back(node.right_child);
+            stack.push_back(static_cast<GLuint>(&node - nodes.data()) + 1);
+        }
+    }
+    visible_count = visible.size();
+
+    // In index buffer order, so that neighbouring clusters are drawn as one range
+    std::sort(visible.begin(), visible.end(),
+              [this](GLuint a, GLuint b) { return clusters[a].first_index < clusters[b].first_index; });
+    for (auto c : visible)
+    {
+        const auto &cluster = clusters[c];
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == cluster.first_index)
+            ranges.back().count += cluster.index_count;
+        else
+            ranges.push_back({cluster.first_index, cluster.index_count});
+    }
+    return ranges;
+}
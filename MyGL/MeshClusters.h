@@ -0,0 +1,82 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+namespace MyGL
+{
+// Splits the triangle list of a mesh into clusters of consecutive triangles, each bounded by a sphere and a cone
+// of its normals, with a bounding sphere hierarchy over them. Every frame, the clusters outside the view frustum
+// and, optionally, those facing away from the camera are culled, the rest is drawn as few index ranges.
+class MeshClusters
+{
+  public:
+    static constexpr GLuint CLUSTER_TRIANGLES = 128;
+
+    struct Cluster
+    {
+        glm::vec3 center;
+        float radius;
+        glm::vec3 cone_axis;
+        float cone_cutoff; // sine of the cone half angle, above 1 if the cluster never faces away entirely
+        GLuint first_index;
+        GLuint index_count;
+    };
+
+    MeshClusters() = default;
+
+    // From the positions and indices of the GL buffers, in model space
+    MeshClusters(std::span<const glm::vec3> positions, std::span<const GLuint> indices);
+
+    bool empty() const
+    {
+        return clusters.empty();
+    }
+
+    size_t size() const
+    {
+        return clusters.size();
+    }
+
+    // Index ranges of the visible clusters, sorted and with adjacent ranges merged, valid until the next call.
+    // Back-facing clusters are only culled on request, the back faces of open meshes can be seen through holes
+    std::span<const Mesh::IndexRange> cull(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection,
+                                           bool cull_backfaces);
+
+    // Number of clusters that passed the last cull
+    size_t get_visible_count() const
+    {
+        return visible_count;
+    }
+
+  private:
+    // Nodes in depth-first order, the left child follows its parent. Each node covers a contiguous range of the
+    // clusters, which are stored in hierarchy order
+    struct Node
+    {
+        glm::vec3 center;
+        float radius;
+        GLuint first_cluster;
+        GLuint cluster_count;
+        GLuint right_child; // 0 for leaves
+    };
+
+    static constexpr GLuint LEAF_SIZE = 4;
+
+    std::vector<Cluster> clusters;
+    std::vector<Node> nodes;
+
+    // Scratch buffers of cull
+    std::vector<GLuint> visible;
+    std::vector<Mesh::IndexRange> ranges;
+    std::vector<GLuint> stack;
+    size_t visible_count = 0;
+
+    GLuint build_node(GLuint first, GLuint count);
+};
+} // namespace MyGL
@@ -0,0 +1,30 @@
+#include "MeshLods.h"
+
+#include <algorithm>
+#include <utility>
+
+MyGL::MeshLods::MeshLods(std::vector<Level> levels, const glm::vec3 &center, float radius)
+    : levels(std::move(levels)), center(center), radius(radius)
+{
+}
+
+size_t MyGL::MeshLods::select(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection,
+                              float viewport_height, float max_pixel_error) const
+{
+    // The nearest point of the sphere has the largest projected error, the model matrix may scale the mesh
+    glm::mat4 model_view = view * model;
+    float scale = std::max({glm::length(glm::vec3(model_view[0])), glm::length(glm::vec3(model_view[1])),
+                            glm::length(glm::vec3(model_view[2]))});
+    float distance = glm::length(glm::vec3(model_view * glm::vec4(center, 1.0f))) - radius * scale;
+    if (distance <= 0.0f)
+        return 0;
+
+    // Pixels covered by a unit length facing the camera at that distance, for a perspective projection
+    float pixels_per_unit = projection[1][1] * 0.5f * viewport_height / distance;
+
+    // The errors grow with the level
+    size_t selected = 0;
+    while (selected + 1 < levels.size() && levels[selected + 1].error * scale * pixels_per_unit <= max_pixel_error)
+        selected++;
+    return selected;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+namespace MyGL
+{
+// Levels of detail of a mesh as ranges of its index buffer over the same vertices, the full resolution first. Every
+// frame, the coarsest level whose error covers at most a given number of pixels is selected, from the distance of
+// the camera to the bounding sphere of the mesh
+class MeshLods
+{
+  public:
+    struct Level
+    {
+        Mesh::IndexRange range;
+        float error; // largest distance to the full resolution surface, in model space
+    };
+
+    MeshLods() = default;
+
+    // Levels ordered from the finest to the coarsest, with their bounding sphere in model space
+    MeshLods(std::vector<Level> levels, const glm::vec3 &center, float radius);
+
+    bool empty() const
+    {
+        return levels.empty();
+    }
+
+    size_t size() const
+    {
+        return levels.size();
+    }
+
+    const Level &get_level(size_t index) const
+    {
+        return levels[index];
+    }
+
+    // Index of the level to draw on a viewport of the given height in pixels, 0 when the camera is inside the sphere
+    size_t select(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection, float viewport_height,
+                  float max_pixel_error) const;
+
+  private:
+    std::vector<Level> levels;
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+};
+} // namespace MyGL
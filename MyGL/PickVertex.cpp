@@ -1,56 +1,238 @@
 #include "PickVertex.h"
 
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
 
+#include "ShaderLibrary.h"
 #include "Utils.h"
 
 MyGL::PickVertex::PickVertex()
-    : vertex_id_shader(read_file_to_string("data/shaders/pick_vertex.vert"),
-                       read_file_to_string("data/shaders/pick_vertex.frag")),
-      round_point_shader(read_file_to_string("data/shaders/basic.vert"),
-                         read_file_to_string("data/shaders/round_point.frag")),
-      basic_shader(read_file_to_string("data/shaders/basic.vert"), read_file_to_string("data/shaders/basic.frag"))
+    : vertex_id_shader(ShaderLibrary::get("data/shaders/pick_vertex.vert", "data/shaders/pick_vertex.frag")),
+      round_point_shader(ShaderLibrary::get("data/shaders/basic.vert", "data/shaders/round_point.frag")),
+      basic_shader(ShaderLibrary::get("data/shaders/basic.vert", "data/shaders/basic.frag"))
 {
+    for (auto &readback : readbacks)
+    {
+        glGenBuffers(1, &readback.PBO);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+MyGL::PickVertex::~PickVertex()
+{
+    for (auto &readback : readbacks)
+    {
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        glDeleteBuffers(1, &readback.PBO);
+    }
+    delete_framebuffer();
 }
 
 int MyGL::PickVertex::pick(const glm::ivec2 &pos, const Mesh &mesh,
                            const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp)
 {
-    GLboolean multisample_enabled;
-    glGetBooleanv(GL_MULTISAMPLE, &multisample_enabled);
-    glDisable(GL_MULTISAMPLE);
+    // Results of earlier frames first, the one requested now arrives in a later frame
+    receive_readbacks(mesh);
+
+    // The ID buffer is only rendered again when its inputs change
+    bool is_changed = pos != last_pos || mvp != last_mvp || &mesh != last_mesh ||
+                      mesh.get_revision() != last_revision;
+    if (!is_changed)
+        return vertex_id;
+
+    auto [width, height] = get_viewport_size();
+    if (pos.x < 0 || pos.y < 0 || pos.x >= width || pos.y >= height)
+    {
+        vertex_id = -1;
+        return vertex_id;
+    }
+
+    // All pixel buffers still in flight, the request is retried next frame
+    auto &readback = readbacks[next_readback];
+    if (readback.fence)
+        return vertex_id;
 
-    glClearColor(0.f, 0.f, 0.f, 0.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    setup_framebuffer({width, height});
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    // Only the pixel under the mouse is rasterized
+    GLboolean scissor_enabled = glIsEnabled(GL_SCISSOR_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(pos.x, pos.y, 1, 1);
+
+    const GLuint no_vertex[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, no_vertex);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // The mesh is drawn with the transform decoding its positions
+    glm::mat4 mesh_model = std::get<0>(mvp) * mesh.get_position_transform();
 
     // Update Z-buffer
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-    basic_shader.use();
-    basic_shader.set_MVP(mvp);
+    basic_shader->use();
+    basic_shader->set_model(mesh_model);
     mesh.draw();
 
     // Draw vertices
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
     glPointSize(pick_point_size);
-    vertex_id_shader.use();
-    vertex_id_shader.set_MVP(mvp);
+    vertex_id_shader->use();
+    vertex_id_shader->set_model(mesh_model);
     mesh.draw(Mesh::DrawMode::POINTS);
 
-    // Read pixel
-    GLubyte pixel[PIXEL_COMPONENTS];
-    glReadPixels(pos.x, pos.y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    // Copy the pixel into the next pixel buffer, the fence tells when it can be mapped without waiting
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+    glReadPixels(pos.x, pos.y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next_readback = (next_readback + 1) % readbacks.size();
+
+    if (!scissor_enabled)
+        glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    last_pos = pos;
+    last_mvp = mvp;
+    last_mesh = &mesh;
+    last_revision = mesh.get_revision();
+    return vertex_id;
+}
+
+void MyGL::PickVertex::receive_readbacks(const Mesh &mesh)
+{
+    // Oldest request first, the GPU completes them in order
+    for (size_t i = 0; i < readbacks.size(); ++i)
+    {
+        auto &readback = readbacks[(next_readback + i) % readbacks.size()];
+        if (!readback.fence)
+            continue;
+        auto status = glClientWaitSync(readback.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+        auto id = static_cast<const GLuint *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint),
+                                                               GL_MAP_READ_BIT));
+        if (id)
+        {
+            vertex_id = static_cast<int>(*id) - 1;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-    int index = static_cast<int>(pixel[0] + (pixel[1] << 8) + (pixel[2] << 16)) - 1;
-    vertex_id = index;
+        // A request made for another mesh may complete after it changed
+        if (vertex_id >= static_cast<int>(mesh.get_num_vertices()))
+            vertex_id = -1;
+        if (vertex_id != -1)
+            picked_position = mesh.get_vertex_position(vertex_id);
+    }
+}
 
-    if (multisample_enabled)
-        glEnable(GL_MULTISAMPLE);
+void MyGL::PickVertex::setup_framebuffer(const glm::ivec2 &size)
+{
+    if (FBO != 0 && size == framebuffer_size)
+        return;
+    delete_framebuffer();
+
+    // Vertex IDs + 1 as unsigned integers, 0 where there is no vertex
+    glGenTextures(1, &id_texture);
+    glBindTexture(GL_TEXTURE_2D, id_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, size.x, size.y, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x, size.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, id_texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+    auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        delete_framebuffer();
+        throw std::runtime_error("Pick setup failed: ID framebuffer is incomplete");
+    }
+    framebuffer_size = size;
+}
+
+void MyGL::PickVertex::delete_framebuffer()
+{
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &id_texture);
+    glDeleteRenderbuffers(1, &depth_renderbuffer);
+    FBO = id_texture = depth_renderbuffer = 0;
+}
+
+int MyGL::PickVertex::pick(const glm::ivec2 &pos, const glm::ivec2 &viewport_size, const MeshBVH &bvh,
+                           const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp)
+{
+    auto [model, view, projection] = mvp;
+    glm::mat4 transform = projection * view * model;
+    glm::vec2 size(viewport_size);
+
+    // Ray through the pixel center, from the near to the far plane
+    glm::vec2 ndc = (glm::vec2(pos) + 0.5f) / size * 2.0f - 1.0f;
+    glm::mat4 inverse = glm::inverse(transform);
+    glm::vec4 near = inverse * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+    glm::vec4 far = inverse * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(near) / near.w;
+    glm::vec3 direction = glm::vec3(far) / far.w - origin;
+
+    // Depth of the surface at the pixel, which hides the vertices behind it
+    float surface_depth = 1.0f;
+    if (auto distance = bvh.intersect(origin, direction, 1.0f))
+    {
+        glm::vec4 hit = transform * glm::vec4(origin + direction * *distance, 1.0f);
+        surface_depth = hit.z / hit.w;
+    }
+
+    // Only vertices within the point radius of the pixel center can cover it
+    float radius = pick_point_size * 0.5f;
+    glm::vec2 center = glm::vec2(pos) + 0.5f;
+    auto planes = get_window_rect_planes(transform, center - radius, center + radius, size);
+    candidates.clear();
+    bvh.find_vertices(planes, candidates);
+
+    // As the depth test of the points, the nearest one wins, ties going to the lower index
+    vertex_id = -1;
+    float nearest_depth = surface_depth;
+    for (auto vertex : candidates)
+    {
+        glm::vec4 clip = transform * glm::vec4(bvh.get_position(vertex), 1.0f);
+        if (clip.w <= 0.0f)
+            continue;
+        glm::vec3 point = glm::vec3(clip) / clip.w;
+        if (std::abs(point.x) > 1.0f || std::abs(point.y) > 1.0f || std::abs(point.z) > 1.0f)
+            continue; // points are clipped by their center
+
+        glm::vec2 offset = (glm::vec2(point.x, point.y) * 0.5f + 0.5f) * size - center;
+        if (glm::dot(offset, offset) > radius * radius)
+            continue;
+        if (point.z < nearest_depth || (point.z == nearest_depth && vertex_id != -1 && int(vertex) < vertex_id))
+        {
+            nearest_depth = point.z;
+            vertex_id = static_cast<int>(vertex);
+        }
+    }
 
-    return index;
+    if (vertex_id != -1)
+        picked_position = bvh.get_position(vertex_id);
+    return vertex_id;
 }
 
-void MyGL::PickVertex::highlight_hovered_vertex(const Mesh &mesh,
-                                                const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp)
+void MyGL::PickVertex::highlight_hovered_vertex(const glm::mat4 &model)
 {
     if (vertex_id == -1)
     {
@@ -58,10 +240,10 @@ void MyGL::PickVertex::highlight_hovered_vertex(const Mesh &mesh,
         return;
     }
 
-    highlighted_vertex.update({mesh.get_vertex_position(vertex_id)});
+    highlighted_vertex.update({picked_position});
 
-    round_point_shader.use();
-    round_point_shader.set_MVP(mvp);
-    round_point_shader.set_uniform("color", highlight_color);
+    round_point_shader->use();
+    round_point_shader->set_model(model);
+    round_point_shader->set_uniform("color", highlight_color);
     highlighted_vertex.draw();
 }
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <array>
+#include <memory>
+#include <tuple>
+#include <vector>
+
 #include "Mesh.h"
+#include "MeshBVH.h"
 #include "Shader.h"
 
 #include "PointCloud.h"
@@ -11,28 +17,63 @@ class PickVertex
 {
   public:
     PickVertex();
+    ~PickVertex();
+
+    PickVertex(const PickVertex &) = delete;
+    PickVertex &operator=(const PickVertex &) = delete;
 
-    // Returns the index of the vertex that was picked, or -1 if no vertex was picked
+    // Renders the vertex IDs around the pixel into an offscreen buffer and reads it back asynchronously: returns the
+    // index of the vertex picked by the latest request that has completed, usually one or two frames old, or -1 if
+    // no vertex was picked. Nothing is rendered if the position, matrices and mesh are the same as last time. The
+    // view and projection must be those of the camera uniforms
     int pick(const glm::ivec2 &pos, const Mesh &mesh, const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp);
 
+    // Same pick on the CPU, without rendering or reading back: the nearest vertex in front of the surface whose point
+    // covers the pixel center, found by casting the pixel ray and querying the vertices around it in the hierarchy
+    int pick(const glm::ivec2 &pos, const glm::ivec2 &viewport_size, const MeshBVH &bvh,
+             const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp);
+
     int get_picked_vertex() const
     {
         return vertex_id;
     }
 
-    void highlight_hovered_vertex(const Mesh &mesh, const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp);
+    void highlight_hovered_vertex(const glm::mat4 &model);
 
   private:
-    ShaderProgram vertex_id_shader;
-    ShaderProgram round_point_shader;
-    ShaderProgram basic_shader;
+    std::shared_ptr<const ShaderProgram> vertex_id_shader;
+    std::shared_ptr<const ShaderProgram> round_point_shader;
+    std::shared_ptr<const ShaderProgram> basic_shader;
+
+    // Offscreen ID buffer, the size of the viewport
+    GLuint FBO = 0, id_texture = 0, depth_renderbuffer = 0;
+    glm::ivec2 framebuffer_size{0};
+
+    // Ring of pixel buffers the picked pixel is copied into, each mapped once its fence is signaled
+    struct Readback
+    {
+        GLuint PBO = 0;
+        GLsync fence = nullptr; // set while the copy is in flight
+    };
+    std::array<Readback, 3> readbacks;
+    size_t next_readback = 0; // the oldest one
+
+    // Inputs of the last rendering of the ID buffer
+    glm::ivec2 last_pos{-1};
+    std::tuple<glm::mat4, glm::mat4, glm::mat4> last_mvp;
+    const Mesh *last_mesh = nullptr;
+    GLuint64 last_revision = 0;
 
     int vertex_id = -1;
+    glm::vec3 picked_position{0.0f}; // in model space
+    std::vector<GLuint> candidates;  // kept to avoid allocations
     float pick_point_size = 15.0f; // TODO: make configurable
     glm::vec4 highlight_color{1.0f, 0.0f, 0.0f, 1.0f};
 
     PointCloud highlighted_vertex;
 
-    static constexpr GLubyte PIXEL_COMPONENTS = 4;
+    void receive_readbacks(const Mesh &mesh);
+    void setup_framebuffer(const glm::ivec2 &size);
+    void delete_framebuffer();
 };
 } // namespace MyGL
\ No newline at end of file
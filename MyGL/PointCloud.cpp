@@ -26,9 +26,9 @@ void MyGL::PointCloud::update(const std::vector<glm::vec3> &vertices)
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_DYNAMIC_DRAW);
 }
 
-void MyGL::PointCloud::draw() const
+void MyGL::PointCloud::draw(float point_size) const
 {
-    glPointSize(15.0); // TODO: remove magic number
+    glPointSize(point_size);
 
     glBindVertexArray(VAO);
     glDrawArrays(GL_POINTS, 0, num_vertices);
@@ -43,7 +43,7 @@ class PointCloud
 
     void update(const std::vector<glm::vec3> &vertices);
 
-    void draw() const;
+    void draw(float point_size = 15.0f) const;
 
   private:
     GLuint VAO, VBO;
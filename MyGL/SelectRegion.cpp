@@ -0,0 +1,250 @@
+#include "SelectRegion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "ShaderLibrary.h"
+#include "Utils.h"
+
+MyGL::SelectRegion::SelectRegion()
+    : depth_shader(ShaderLibrary::get("data/shaders/basic.vert", "data/shaders/basic.frag")),
+      round_point_shader(ShaderLibrary::get("data/shaders/basic.vert", "data/shaders/round_point.frag"))
+{
+    glGenBuffers(1, &PBO);
+}
+
+MyGL::SelectRegion::~SelectRegion()
+{
+    glDeleteBuffers(1, &PBO);
+    delete_framebuffer();
+}
+
+std::vector<glm::vec2> MyGL::SelectRegion::box(const glm::vec2 &from, const glm::vec2 &to)
+{
+    glm::vec2 min(std::min(from.x, to.x), std::min(from.y, to.y));
+    glm::vec2 max(std::max(from.x, to.x), std::max(from.y, to.y));
+    return {min, {max.x, min.y}, max, {min.x, max.y}};
+}
+
+void MyGL::SelectRegion::select(std::span<const glm::vec2> polygon, const Mesh &mesh, const MeshBVH &bvh,
+                                const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp, Mode mode, bool is_additive)
+{
+    if (!is_additive || selection.size() != bvh.get_num_vertices())
+        selection.reset(bvh.get_num_vertices());
+
+    // Pixels whose center may be inside the polygon
+    auto [width, height] = get_viewport_size();
+    glm::vec2 polygon_min(std::numeric_limits<float>::max()), polygon_max(std::numeric_limits<float>::lowest());
+    for (const auto &point : polygon)
+    {
+        polygon_min = glm::vec2(std::min(polygon_min.x, point.x), std::min(polygon_min.y, point.y));
+        polygon_max = glm::vec2(std::max(polygon_max.x, point.x), std::max(polygon_max.y, point.y));
+    }
+    glm::ivec2 min(std::max(0, static_cast<int>(std::floor(polygon_min.x))),
+                   std::max(0, static_cast<int>(std::floor(polygon_min.y))));
+    glm::ivec2 max(std::min(width, static_cast<int>(std::ceil(polygon_max.x))),
+                   std::min(height, static_cast<int>(std::ceil(polygon_max.y))));
+    if (polygon.size() < 3 || min.x >= max.x || min.y >= max.y)
+    {
+        update_highlighted_vertices(bvh);
+        return;
+    }
+
+    // The GPU renders the depth while the CPU finds the candidates and rasterizes the region
+    if (mode == Mode::VISIBLE)
+        read_depth(min, max, mesh, std::get<0>(mvp));
+
+    auto [model, view, projection] = mvp;
+    glm::mat4 transform = projection * view * model;
+    glm::vec2 viewport_size(width, height);
+    candidates.clear();
+    bvh.find_vertices(get_window_rect_planes(transform, glm::vec2(min), glm::vec2(max), viewport_size), candidates);
+    rasterize(polygon, min, max);
+
+    const GLfloat *depths = nullptr;
+    if (mode == Mode::VISIBLE)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, PBO);
+        depths = static_cast<const GLfloat *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, PBO_size, GL_MAP_READ_BIT));
+        if (!depths)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            throw std::runtime_error("Selection failed: Failed to map the depth buffer");
+        }
+    }
+
+    // Each candidate is a different vertex, so threads only share the words of the bitset
+    int region_width = max.x - min.x, region_height = max.y - min.y;
+    auto select_candidates = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            GLuint vertex = candidates[i];
+            glm::vec4 clip = transform * glm::vec4(bvh.get_position(vertex), 1.0f);
+            if (clip.w <= 0.0f)
+                continue;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            if (std::abs(ndc.z) > 1.0f)
+                continue;
+
+            int x = static_cast<int>(std::floor((ndc.x * 0.5f + 0.5f) * viewport_size.x)) - min.x;
+            int y = static_cast<int>(std::floor((ndc.y * 0.5f + 0.5f) * viewport_size.y)) - min.y;
+            if (x < 0 || y < 0 || x >= region_width || y >= region_height)
+                continue;
+            size_t pixel = size_t(y) * region_width + x;
+            if (!mask[pixel])
+                continue;
+
+            // The polygon offset of the depth pass keeps the vertices on the surface in front of it
+            if (depths && ndc.z * 0.5f + 0.5f > depths[pixel])
+                continue;
+            selection.set_atomic(vertex);
+        }
+    };
+
+    unsigned num_threads = 1;
+    if (candidates.size() >= MIN_PARALLEL_VERTICES)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunk_size = (candidates.size() + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; ++t)
+        threads.emplace_back(select_candidates, std::min(t * chunk_size, candidates.size()),
+                             std::min((t + 1) * chunk_size, candidates.size()));
+    select_candidates(0, std::min(chunk_size, candidates.size()));
+    for (auto &thread : threads)
+        thread.join();
+
+    if (depths)
+    {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    update_highlighted_vertices(bvh);
+}
+
+void MyGL::SelectRegion::clear()
+{
+    selection.reset(selection.size());
+    num_selected = 0;
+    highlighted_vertices.update({});
+}
+
+void MyGL::SelectRegion::highlight_selected_vertices(const glm::mat4 &model)
+{
+    if (num_selected == 0)
+        return;
+
+    round_point_shader->use();
+    round_point_shader->set_model(model);
+    round_point_shader->set_uniform("color", highlight_color);
+    highlighted_vertices.draw(highlight_point_size);
+}
+
+void MyGL::SelectRegion::read_depth(const glm::ivec2 &min, const glm::ivec2 &max, const Mesh &mesh,
+                                    const glm::mat4 &model)
+{
+    auto [width, height] = get_viewport_size();
+    setup_framebuffer({width, height});
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    GLboolean scissor_enabled = glIsEnabled(GL_SCISSOR_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(min.x, min.y, max.x - min.x, max.y - min.y);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    depth_shader->use();
+    depth_shader->set_model(model * mesh.get_position_transform());
+    mesh.draw();
+
+    // Copied into the pixel buffer on the GPU, mapping it waits for the copy
+    GLsizeiptr size = GLsizeiptr(max.x - min.x) * (max.y - min.y) * sizeof(GLfloat);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, PBO);
+    if (size != PBO_size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        PBO_size = size;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(min.x, min.y, max.x - min.x, max.y - min.y, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!scissor_enabled)
+        glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void MyGL::SelectRegion::setup_framebuffer(const glm::ivec2 &size)
+{
+    if (FBO != 0 && size == framebuffer_size)
+        return;
+    delete_framebuffer();
+
+    glGenRenderbuffers(1, &depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x, size.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    // Depth only, without color buffers to draw into or read from
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        delete_framebuffer();
+        throw std::runtime_error("Selection setup failed: depth framebuffer is incomplete");
+    }
+    framebuffer_size = size;
+}
+
+void MyGL::SelectRegion::delete_framebuffer()
+{
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(1, &depth_renderbuffer);
+    FBO = depth_renderbuffer = 0;
+}
+
+void MyGL::SelectRegion::rasterize(std::span<const glm::vec2> polygon, const glm::ivec2 &min, const glm::ivec2 &max)
+{
+    int region_width = max.x - min.x, region_height = max.y - min.y;
+    mask.assign(size_t(region_width) * region_height, 0);
+
+    // Spans between pairs of edge crossings of each row of pixel centers
+    std::vector<float> crossings;
+    for (int y = 0; y < region_height; ++y)
+    {
+        float center_y = min.y + y + 0.5f;
+        crossings.clear();
+        for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+        {
+            const auto &a = polygon[j], &b = polygon[i];
+            if ((a.y > center_y) != (b.y > center_y))
+                crossings.push_back(a.x + (center_y - a.y) / (b.y - a.y) * (b.x - a.x));
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        auto row = mask.begin() + size_t(y) * region_width;
+        for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+        {
+            // Pixels with their center in [crossings[k], crossings[k + 1])
+            int begin = std::max(0, static_cast<int>(std::ceil(crossings[k] - 0.5f)) - min.x);
+            int end = std::min(region_width, static_cast<int>(std::ceil(crossings[k + 1] - 0.5f)) - min.x);
+            if (begin < end)
+                std::fill(row + begin, row + end, 1);
+        }
+    }
+}
+
+void MyGL::SelectRegion::update_highlighted_vertices(const MeshBVH &bvh)
+{
+    std::vector<glm::vec3> positions;
+    selection.for_each([&](size_t vertex) { positions.push_back(bvh.get_position(static_cast<GLuint>(vertex))); });
+    num_selected = positions.size();
+    highlighted_vertices.update(positions);
+}
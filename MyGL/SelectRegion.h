@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshBVH.h"
+#include "PointCloud.h"
+#include "SelectionBitset.h"
+#include "Shader.h"
+
+namespace MyGL
+{
+// Selects the vertices that project into a region of the window, a box or a lasso. The candidates are found in the
+// BVH and tested against the region rasterized into a pixel mask, on several threads. Selecting only the visible
+// vertices additionally tests them against the depth of the mesh, rendered on the GPU while the CPU looks for the
+// candidates
+class SelectRegion
+{
+  public:
+    enum class Mode
+    {
+        VISIBLE,    // vertices hidden by the mesh are left out
+        SEE_THROUGH // all vertices in the region
+    };
+
+    SelectRegion();
+    ~SelectRegion();
+
+    SelectRegion(const SelectRegion &) = delete;
+    SelectRegion &operator=(const SelectRegion &) = delete;
+
+    // The polygon is in window coordinates with the origin at the bottom left, a rectangle for box selection.
+    // Replaces the selection with the GL vertices inside it, or adds them to it. The view and projection must be those
+    // of the camera uniforms
+    void select(std::span<const glm::vec2> polygon, const Mesh &mesh, const MeshBVH &bvh,
+                const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp, Mode mode, bool is_additive = false);
+
+    // Corners of a box selection dragged between two points
+    static std::vector<glm::vec2> box(const glm::vec2 &from, const glm::vec2 &to);
+
+    const SelectionBitset &get_selection() const
+    {
+        return selection;
+    }
+    size_t get_num_selected() const
+    {
+        return num_selected;
+    }
+
+    void clear();
+
+    void highlight_selected_vertices(const glm::mat4 &model);
+
+  private:
+    std::shared_ptr<const ShaderProgram> depth_shader;
+    std::shared_ptr<const ShaderProgram> round_point_shader;
+
+    // Offscreen depth buffer the size of the viewport, its region is read back through a pixel buffer
+    GLuint FBO = 0, depth_renderbuffer = 0;
+    glm::ivec2 framebuffer_size{0};
+    GLuint PBO = 0;
+    GLsizeiptr PBO_size = 0;
+
+    SelectionBitset selection;
+    size_t num_selected = 0;
+    PointCloud highlighted_vertices;
+    float highlight_point_size = 5.0f;
+    glm::vec4 highlight_color{0.1f, 0.4f, 0.9f, 1.0f};
+
+    // Kept to avoid allocations
+    std::vector<GLuint> candidates;
+    std::vector<GLubyte> mask;
+
+    static constexpr size_t MIN_PARALLEL_VERTICES = 1 << 14; // fewer candidates are tested on the current thread
+
+    // Starts reading back the depth of the mesh in the rectangle [min, max) of the viewport
+    void read_depth(const glm::ivec2 &min, const glm::ivec2 &max, const Mesh &mesh, const glm::mat4 &model);
+    void setup_framebuffer(const glm::ivec2 &size);
+    void delete_framebuffer();
+
+    // Sets the pixels of the rectangle whose center is inside the polygon, by the even-odd rule
+    void rasterize(std::span<const glm::vec2> polygon, const glm::ivec2 &min, const glm::ivec2 &max);
+    void update_highlighted_vertices(const MeshBVH &bvh);
+};
+} // namespace MyGL
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace MyGL
+{
+// Set of element indices, e.g. of selected vertices, one bit each
+class SelectionBitset
+{
+  public:
+    // Empties the set and makes room for indices below size
+    void reset(size_t size)
+    {
+        words.assign((size + WORD_BITS - 1) / WORD_BITS, 0);
+        num_bits = size;
+    }
+
+    size_t size() const
+    {
+        return num_bits;
+    }
+
+    bool test(size_t index) const
+    {
+        return (words[index / WORD_BITS] >> (index % WORD_BITS)) & 1;
+    }
+
+    void set(size_t index)
+    {
+        words[index / WORD_BITS] |= std::uint64_t(1) << (index % WORD_BITS);
+    }
+
+    // May be called from several threads at once, with no other access meanwhile
+    void set_atomic(size_t index)
+    {
+        std::atomic_ref<std::uint64_t>(words[index / WORD_BITS])
+            .fetch_or(std::uint64_t(1) << (index % WORD_BITS), std::memory_order_relaxed);
+    }
+
+    size_t count() const
+    {
+        size_t count = 0;
+        for (auto word : words)
+            count += std::popcount(word);
+        return count;
+    }
+
+    // Calls function with each index in the set, in increasing order
+    template <typename Function> void for_each(Function function) const
+    {
+        for (size_t w = 0; w < words.size(); ++w)
+            for (auto word = words[w]; word != 0; word &= word - 1)
+                function(w * WORD_BITS + std::countr_zero(word));
+    }
+
+  private:
+    static constexpr size_t WORD_BITS = 64;
+
+    std::vector<std::uint64_t> words;
+    size_t num_bits = 0;
+};
+} // namespace MyGL
@@ -24,9 +24,6 @@ MyGL::Shader::~Shader()
 
 void MyGL::Shader::create_shader(GLenum shader_type)
 {
-    if (!gladLoadGL())
-        throw std::runtime_error("No valid OpenGL context");
-
     switch (type)
     {
     case GL_VERTEX_SHADER:
@@ -77,12 +74,32 @@ MyGL::ShaderProgram::ShaderProgram(const std::string &vertex_source, const std::
     for (const auto &shader : shaders)
         glAttachShader(ID, shader.get_ID());
 
+    if (is_binary_supported())
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     link_shader_program();
 
     for (const auto &shader : shaders)
         glDetachShader(ID, shader.get_ID());
 }
 
+MyGL::ShaderProgram::ShaderProgram(GLenum binary_format, std::span<const std::byte> binary)
+{
+    create_shader_program();
+    glProgramBinary(ID, binary_format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    // Fails when the driver has changed since the binary was saved
+    int success;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(ID);
+        ID = 0;
+        throw std::runtime_error("Failed to load program binary");
+    }
+
+    find_uniforms();
+}
+
 MyGL::ShaderProgram::~ShaderProgram()
 {
     if (ID != 0)
@@ -120,61 +137,133 @@ void MyGL::ShaderProgram::link_shader_program()
         glGetProgramInfoLog(ID, MAX_ERROR_LOG_LENGTH, nullptr, info_log);
         throw std::runtime_error("Failed to link program: " + std::string(info_log));
     }
+
+    find_uniforms();
+}
+
+void MyGL::ShaderProgram::find_uniforms()
+{
+    GLint num_uniforms = 0, max_name_length = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &num_uniforms);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+    std::vector<GLchar> name(max_name_length + 1);
+    for (GLint i = 0; i < num_uniforms; ++i)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+
+        // Members of uniform blocks have no location, arrays are set by their name without [0]
+        GLint location = glGetUniformLocation(ID, name.data());
+        if (location == -1)
+            continue;
+        std::string_view uniform_name(name.data(), length);
+        if (uniform_name.ends_with("[0]"))
+            uniform_name.remove_suffix(3);
+        uniform_locations.emplace(uniform_name, location);
+    }
+
+    GLuint camera_block = glGetUniformBlockIndex(ID, "Camera");
+    if (camera_block != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, camera_block, CAMERA_UNIFORMS_BINDING);
 }
 
-GLint MyGL::ShaderProgram::get_uniform_location(const std::string &name) const
+GLint MyGL::ShaderProgram::get_uniform_location(std::string_view name) const
 {
-    GLint location = glGetUniformLocation(ID, name.c_str());
-    if (location == -1)
-        throw std::runtime_error("Uniform " + name + " not found in shader program");
-    return location;
+    auto it = uniform_locations.find(name);
+    if (it == uniform_locations.end())
+        throw std::runtime_error("Uniform " + std::string(name) + " not found in shader program");
+    return it->second;
 }
 
-void MyGL::ShaderProgram::set_uniform(const std::string &name, const bool &value) const
+void MyGL::ShaderProgram::set_uniform(std::string_view name, const bool &value) const
 {
     glUniform1i(get_uniform_location(name), value);
 }
 
-void MyGL::ShaderProgram::set_uniform(const std::string &name, const int &value) const
+void MyGL::ShaderProgram::set_uniform(std::string_view name, const int &value) const
 {
     glUniform1i(get_uniform_location(name), value);
 }
 
-void MyGL::ShaderProgram::set_uniform(const std::string &name, const float &value) const
+void MyGL::ShaderProgram::set_uniform(std::string_view name, const float &value) const
 {
     glUniform1f(get_uniform_location(name), value);
 }
 
-void MyGL::ShaderProgram::set_uniform(const std::string &name, const glm::vec3 &value) const
+void MyGL::ShaderProgram::set_uniform(std::string_view name, const glm::vec2 &value) const
+{
+    glUniform2fv(get_uniform_location(name), 1, &value[0]);
+}
+
+void MyGL::ShaderProgram::set_uniform(std::string_view name, const glm::vec3 &value) const
 {
     glUniform3fv(get_uniform_location(name), 1, &value[0]);
 }
 
-void MyGL::ShaderProgram::set_uniform(const std::string &name, const glm::vec4 &value) const
+void MyGL::ShaderProgram::set_uniform(std::string_view name, const glm::vec4 &value) const
 {
     glUniform4fv(get_uniform_location(name), 1, &value[0]);
 }
 
-void MyGL::ShaderProgram::set_uniform(const std::string &name, const glm::mat3 &value) const
+void MyGL::ShaderProgram::set_uniform(std::string_view name, const glm::mat3 &value) const
 {
     glUniformMatrix3fv(get_uniform_location(name), 1, GL_FALSE, &value[0][0]);
 }
 
-void MyGL::ShaderProgram::set_uniform(const std::string &name, const glm::mat4 &value) const
+void MyGL::ShaderProgram::set_uniform(std::string_view name, const glm::mat4 &value) const
 {
     glUniformMatrix4fv(get_uniform_location(name), 1, GL_FALSE, &value[0][0]);
 }
 
-void MyGL::ShaderProgram::set_MVP(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection) const
+void MyGL::ShaderProgram::set_model(const glm::mat4 &model) const
 {
     set_uniform("model", model);
-    set_uniform("view", view);
-    set_uniform("projection", projection);
 }
 
-void MyGL::ShaderProgram::set_MVP(const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp) const
+bool MyGL::ShaderProgram::is_binary_supported()
+{
+    // Core since OpenGL 4.1, the 3.3 context has it if the driver supports ARB_get_program_binary
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    return num_formats > 0;
+}
+
+std::vector<std::byte> MyGL::ShaderProgram::get_binary(GLenum &binary_format) const
+{
+    GLint length = 0;
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    std::vector<std::byte> binary(length);
+    if (length == 0)
+        return binary;
+
+    GLsizei written = 0;
+    glGetProgramBinary(ID, length, &written, &binary_format, binary.data());
+    binary.resize(written);
+    return binary;
+}
+
+MyGL::CameraUniforms::CameraUniforms()
+{
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_UNIFORMS_BINDING, UBO);
+}
+
+MyGL::CameraUniforms::~CameraUniforms()
+{
+    glDeleteBuffers(1, &UBO);
+}
+
+void MyGL::CameraUniforms::update(const glm::mat4 &view, const glm::mat4 &projection)
 {
-    set_uniform("model", std::get<0>(mvp));
-    set_uniform("view", std::get<1>(mvp));
-    set_uniform("projection", std::get<2>(mvp));
+    // std140 lays out a mat4 as four vec4 columns, like glm
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &view[0][0]);
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), &projection[0][0]);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
\ No newline at end of file
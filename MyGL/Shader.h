@@ -1,6 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -9,6 +15,9 @@ namespace MyGL
 {
 constexpr size_t MAX_ERROR_LOG_LENGTH = 1024;
 
+// Binding point of the uniform block named Camera, in every program that declares it
+constexpr GLuint CAMERA_UNIFORMS_BINDING = 0;
+
 class Shader
 {
   public:
@@ -56,12 +65,15 @@ class ShaderProgram
   public:
     ShaderProgram(const std::string &vertex_source, const std::string &fragment_source,
                   const std::string &geometry_source = "");
+    // Loads a binary from get_binary, throws if the driver doesn't accept it anymore
+    ShaderProgram(GLenum binary_format, std::span<const std::byte> binary);
     ~ShaderProgram();
 
     ShaderProgram(const ShaderProgram &) = delete;
     ShaderProgram &operator=(const ShaderProgram &) = delete;
 
-    ShaderProgram(ShaderProgram &&other) noexcept : ID(other.ID)
+    ShaderProgram(ShaderProgram &&other) noexcept
+        : ID(other.ID), uniform_locations(std::move(other.uniform_locations))
     {
         other.ID = 0;
     }
@@ -71,8 +83,10 @@ class ShaderProgram
         {
             glDeleteProgram(ID);
             ID = other.ID;
+            uniform_locations = std::move(other.uniform_locations);
             other.ID = 0;
         }
+        return *this;
     }
 
     GLuint get_ID() const
@@ -89,26 +103,62 @@ class ShaderProgram
         glUseProgram(0);
     }
 
-    // TODO: Uniform caching
-    void set_uniform(const std::string &name, const bool &value) const;
-    void set_uniform(const std::string &name, const int &value) const;
-    void set_uniform(const std::string &name, const float &value) const;
-    void set_uniform(const std::string &name, const glm::vec3 &value) const;
-    void set_uniform(const std::string &name, const glm::vec4 &value) const;
-    void set_uniform(const std::string &name, const glm::mat3 &value) const;
-    void set_uniform(const std::string &name, const glm::mat4 &value) const;
+    // By the location found when linking, no GL query per call; throws for a name that isn't an active uniform
+    void set_uniform(std::string_view name, const bool &value) const;
+    void set_uniform(std::string_view name, const int &value) const;
+    void set_uniform(std::string_view name, const float &value) const;
+    void set_uniform(std::string_view name, const glm::vec2 &value) const;
+    void set_uniform(std::string_view name, const glm::vec3 &value) const;
+    void set_uniform(std::string_view name, const glm::vec4 &value) const;
+    void set_uniform(std::string_view name, const glm::mat3 &value) const;
+    void set_uniform(std::string_view name, const glm::mat4 &value) const;
 
-    void set_MVP(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection) const;
-    void set_MVP(const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp) const;
+    // The view and projection matrices come from the Camera uniform block, see CameraUniforms
+    void set_model(const glm::mat4 &model) const;
+
+    // Whether the driver can save and load linked programs
+    static bool is_binary_supported();
+    // The linked program in the format of the driver, empty if it cannot be retrieved
+    std::vector<std::byte> get_binary(GLenum &binary_format) const;
 
   private:
+    // Hashes string views like strings, so that looking up a literal doesn't build a string
+    struct NameHash
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view name) const
+        {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
     GLuint ID{0};
+    std::unordered_map<std::string, GLint, NameHash, std::equal_to<>> uniform_locations; // found once linked
 
     void create_shader_program();
     void attach_shader(Shader &&shader);
     void attach_shader(const Shader &shader);
     void link_shader_program();
+    void find_uniforms();
 
-    GLint get_uniform_location(const std::string &name) const;
+    GLint get_uniform_location(std::string_view name) const;
+};
+
+// Uniform buffer with the matrices of the Camera block, shared by all programs and updated once per frame:
+//     layout(std140) uniform Camera { mat4 view; mat4 projection; };
+class CameraUniforms
+{
+  public:
+    CameraUniforms();
+    ~CameraUniforms();
+
+    CameraUniforms(const CameraUniforms &) = delete;
+    CameraUniforms &operator=(const CameraUniforms &) = delete;
+
+    void update(const glm::mat4 &view, const glm::mat4 &projection);
+
+  private:
+    GLuint UBO = 0;
 };
 } // namespace MyGL
\ No newline at end of file
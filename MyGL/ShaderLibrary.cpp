@@ -0,0 +1,176 @@
+#include "ShaderLibrary.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "Utils.h"
+
+namespace
+{
+constexpr char MAGIC[8] = {'G', 'L', 'P', 'R', 'O', 'G', 'B', 'N'};
+constexpr std::uint32_t VERSION = 1;
+const std::string BINARY_DIRECTORY = "data/shaders/cache";
+
+struct BinaryHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t format; // of the driver
+    std::uint64_t key;
+    std::uint64_t size;
+};
+
+// FNV-1a of each string and its length, so that moving text between sources changes the hash
+class Hash
+{
+  public:
+    void add(const void *data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<const unsigned char *>(data)[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    void add(const std::string &text)
+    {
+        std::uint64_t size = text.size();
+        add(&size, sizeof(size));
+        add(text.data(), text.size());
+    }
+
+    std::uint64_t get() const
+    {
+        return hash;
+    }
+
+  private:
+    std::uint64_t hash = 14695981039346656037ull;
+};
+
+std::string get_gl_string(GLenum name)
+{
+    auto string = reinterpret_cast<const char *>(glGetString(name));
+    return string ? string : "";
+}
+} // namespace
+
+std::shared_ptr<const MyGL::ShaderProgram> MyGL::ShaderLibrary::get(const std::string &vertex_path,
+                                                                     const std::string &fragment_path,
+                                                                     const std::string &geometry_path)
+{
+    std::string vertex_source = read_file_to_string(vertex_path);
+    std::string fragment_source = read_file_to_string(fragment_path);
+    std::string geometry_source = geometry_path.empty() ? "" : read_file_to_string(geometry_path);
+
+    Hash hash;
+    hash.add(&VERSION, sizeof(VERSION));
+    hash.add(vertex_source);
+    hash.add(fragment_source);
+    hash.add(geometry_source);
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        hash.add(get_gl_string(name));
+    std::uint64_t key = hash.get();
+
+    auto &cached = programs[key];
+    if (auto program = cached.lock())
+        return program;
+
+    auto program = load_binary(key);
+    if (program)
+        ++num_loaded;
+    else
+    {
+        program = std::make_shared<const ShaderProgram>(vertex_source, fragment_source, geometry_source);
+        ++num_compiled;
+        write_binary(key, *program);
+    }
+    cached = program;
+    return program;
+}
+
+std::string MyGL::ShaderLibrary::binary_filename(std::uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.cache", static_cast<unsigned long long>(key));
+    return BINARY_DIRECTORY + "/" + name;
+}
+
+std::shared_ptr<const MyGL::ShaderProgram> MyGL::ShaderLibrary::load_binary(std::uint64_t key)
+{
+    if (!ShaderProgram::is_binary_supported())
+        return nullptr;
+
+    auto filename = binary_filename(key);
+    std::error_code error;
+    auto file_size = std::filesystem::file_size(filename, error);
+    if (error)
+        return nullptr;
+
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        return nullptr;
+    BinaryHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        !std::equal(std::begin(MAGIC), std::end(MAGIC), header.magic) || header.version != VERSION ||
+        header.key != key)
+        return nullptr;
+
+    // A corrupt size must not allocate more than the file holds, the binary is the rest of it
+    if (header.size != file_size - sizeof(header))
+        return nullptr;
+    std::vector<std::byte> binary(header.size);
+    if (!in.read(reinterpret_cast<char *>(binary.data()), binary.size()))
+        return nullptr;
+
+    // A rejected binary is compiled again and overwritten
+    try
+    {
+        return std::make_shared<const ShaderProgram>(static_cast<GLenum>(header.format), binary);
+    }
+    catch (const std::exception &)
+    {
+        return nullptr;
+    }
+}
+
+bool MyGL::ShaderLibrary::write_binary(std::uint64_t key, const ShaderProgram &program)
+{
+    if (!ShaderProgram::is_binary_supported())
+        return false;
+
+    GLenum format = 0;
+    auto binary = program.get_binary(format);
+    if (binary.empty())
+        return false;
+
+    BinaryHeader header{};
+    std::copy(std::begin(MAGIC), std::end(MAGIC), header.magic);
+    header.version = VERSION;
+    header.format = format;
+    header.key = key;
+    header.size = binary.size();
+
+    // Written under a temporary name and renamed, so that a reader never loads a partially written binary
+    std::error_code error;
+    std::filesystem::create_directories(BINARY_DIRECTORY, error);
+    auto filename = binary_filename(key);
+    auto temporary_filename = filename + ".tmp";
+    {
+        std::ofstream out(temporary_filename, std::ios::binary);
+        if (!out)
+            return false;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(binary.data()), binary.size());
+        if (!out)
+            return false;
+    }
+
+    std::filesystem::rename(temporary_filename, filename, error);
+    return !error;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "Shader.h"
+
+namespace MyGL
+{
+// Process-wide cache of shader programs, used from the thread of the GL context. Programs with the same sources are
+// compiled once and shared by everyone asking for them while any of them holds it. Linked programs are also saved
+// as binaries of the driver, so that later launches load them without compiling.
+// A binary is stale as soon as a source or the driver changes, its file name being the hash of both.
+class ShaderLibrary
+{
+  public:
+    // The program of the shader files, an empty geometry path for none
+    static std::shared_ptr<const ShaderProgram> get(const std::string &vertex_path, const std::string &fragment_path,
+                                                    const std::string &geometry_path = "");
+
+    // Programs compiled from source and loaded from binaries so far
+    static size_t get_num_compiled()
+    {
+        return num_compiled;
+    }
+    static size_t get_num_loaded()
+    {
+        return num_loaded;
+    }
+
+  private:
+    // By the hash of their sources and of the driver, released when their last user goes away, which must be
+    // before the GL context does
+    static inline std::unordered_map<std::uint64_t, std::weak_ptr<const ShaderProgram>> programs;
+    static inline size_t num_compiled = 0;
+    static inline size_t num_loaded = 0;
+
+    static std::string binary_filename(std::uint64_t key);
+    static std::shared_ptr<const ShaderProgram> load_binary(std::uint64_t key);
+    static bool write_binary(std::uint64_t key, const ShaderProgram &program);
+};
+} // namespace MyGL
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 
 #include "glad/glad.h"
+#include <glm/glm.hpp>
 
 namespace MyGL
 {
@@ -22,4 +24,17 @@ inline std::tuple<int, int> get_viewport_size()
     glGetIntegerv(GL_VIEWPORT, viewport);
     return {viewport[2], viewport[3]};
 }
+
+// Planes bounding the part of the view volume that projects into a rectangle of the viewport, in the space that the
+// transform maps to clip space. (a, b, c, d) means a x + b y + c z + d >= 0 inside. They combine the rows of the
+// transform, e.g. x_clip >= x_min w_clip for the left side
+inline std::array<glm::vec4, 6> get_window_rect_planes(const glm::mat4 &transform, const glm::vec2 &min,
+                                                       const glm::vec2 &max, const glm::vec2 &viewport_size)
+{
+    glm::vec2 ndc_min = min / viewport_size * 2.0f - 1.0f;
+    glm::vec2 ndc_max = max / viewport_size * 2.0f - 1.0f;
+    glm::mat4 rows = glm::transpose(transform);
+    return {rows[0] - rows[3] * ndc_min.x, rows[3] * ndc_max.x - rows[0], rows[1] - rows[3] * ndc_min.y,
+            rows[3] * ndc_max.y - rows[1], rows[2] + rows[3],             rows[3] - rows[2]};
+}
 } // namespace MyGL
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "ObjReader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace
+{
+constexpr int MISSING = std::numeric_limits<int>::min();
+
+// Position, texture coordinate and normal index of a face corner, zero-based
+struct Corner
+{
+    int position = MISSING;
+    int texcoord = MISSING;
+    int normal = MISSING;
+    std::uint8_t relative = 0; // RELATIVE_* bits of the indices that are relative to the start of the chunk
+};
+
+constexpr std::uint8_t RELATIVE_POSITION = 1;
+constexpr std::uint8_t RELATIVE_TEXCOORD = 2;
+constexpr std::uint8_t RELATIVE_NORMAL = 4;
+
+// Everything parsed from one chunk of the file. Negative OBJ indices count back from the last element read,
+// which for a chunk is only known relative to its start until the preceding chunks are parsed.
+struct Chunk
+{
+    std::vector<Mesh::Point> positions;
+    std::vector<Mesh::TexCoord2D> texcoords;
+    std::vector<Mesh::Normal> normals;
+    std::vector<Corner> corners;
+    std::vector<std::uint32_t> face_sizes; // number of corners of each face, the corners being consecutive
+    bool is_valid = true;
+};
+
+const char *skip_spaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    return p;
+}
+
+bool parse_number(const char *&p, const char *end, double &value)
+{
+    p = skip_spaces(p, end);
+    if (p < end && *p == '+')
+        ++p;
+    auto [next, error] = std::from_chars(p, end, value);
+    if (error != std::errc())
+        return false;
+    p = next;
+    return true;
+}
+
+// OBJ indices are one-based, negative ones are relative to the number of elements read so far
+bool parse_index(const char *&p, const char *end, size_t count, int &index, std::uint8_t &relative,
+                 std::uint8_t relative_bit)
+{
+    int value;
+    auto [next, error] = std::from_chars(p, end, value);
+    if (error != std::errc() || value == 0)
+        return false;
+    p = next;
+    if (value > 0)
+        index = value - 1;
+    else
+    {
+        index = static_cast<int>(count) + value;
+        relative |= relative_bit;
+    }
+    return true;
+}
+
+void parse_line(const char *p, const char *end, Chunk &chunk)
+{
+    p = skip_spaces(p, end);
+    if (p == end || *p == '#')
+        return;
+
+    auto is_tag = [&](std::string_view tag) {
+        return size_t(end - p) > tag.size() && std::string_view(p, tag.size()) == tag &&
+               (p[tag.size()] == ' ' || p[tag.size()] == '\t');
+    };
+
+    if (is_tag("v"))
+    {
+        p += 1;
+        Mesh::Point point;
+        if (!parse_number(p, end, point[0]) || !parse_number(p, end, point[1]) || !parse_number(p, end, point[2]))
+            chunk.is_valid = false;
+        chunk.positions.push_back(point);
+    }
+    else if (is_tag("vt"))
+    {
+        p += 2;
+        Mesh::TexCoord2D texcoord(0.0, 0.0);
+        if (!parse_number(p, end, texcoord[0]))
+            chunk.is_valid = false;
+        parse_number(p, end, texcoord[1]); // optional
+        chunk.texcoords.push_back(texcoord);
+    }
+    else if (is_tag("vn"))
+    {
+        p += 2;
+        Mesh::Normal normal;
+        if (!parse_number(p, end, normal[0]) || !parse_number(p, end, normal[1]) || !parse_number(p, end, normal[2]))
+            chunk.is_valid = false;
+        chunk.normals.push_back(normal);
+    }
+    else if (is_tag("f"))
+    {
+        p += 1;
+        std::uint32_t size = 0;
+        while ((p = skip_spaces(p, end)) < end && *p != '#')
+        {
+            // v, v/vt, v//vn or v/vt/vn
+            Corner corner;
+            bool ok = parse_index(p, end, chunk.positions.size(), corner.position, corner.relative, RELATIVE_POSITION);
+            if (ok && p < end && *p == '/')
+            {
+                ++p;
+                if (p < end && *p != '/')
+                    ok = parse_index(p, end, chunk.texcoords.size(), corner.texcoord, corner.relative,
+                                     RELATIVE_TEXCOORD);
+                if (ok && p < end && *p == '/')
+                {
+                    ++p;
+                    ok = parse_index(p, end, chunk.normals.size(), corner.normal, corner.relative, RELATIVE_NORMAL);
+                }
+            }
+            if (!ok)
+            {
+                chunk.is_valid = false;
+                break;
+            }
+            chunk.corners.push_back(corner);
+            size++;
+        }
+        chunk.face_sizes.push_back(size);
+    }
+}
+
+void parse_chunk(std::string_view text, Chunk &chunk)
+{
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end && chunk.is_valid)
+    {
+        auto line_end = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!line_end)
+            line_end = end;
+        auto content_end = line_end > p && line_end[-1] == '\r' ? line_end - 1 : line_end;
+        parse_line(p, content_end, chunk);
+        p = line_end + 1;
+    }
+}
+} // namespace
+
+bool ObjReader::read(Mesh &mesh, const std::string &filename, unsigned num_threads)
+{
+    MappedFile file(filename);
+    if (!file.is_open())
+    {
+        mesh.clear();
+        return false;
+    }
+    auto text = file.view();
+
+    // Chunks of at least a megabyte, split after a line break
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t num_chunks = std::clamp<size_t>(text.size() >> 20, 1, num_threads);
+    std::vector<size_t> bounds(num_chunks + 1, text.size());
+    bounds[0] = 0;
+    for (size_t i = 1; i < num_chunks; ++i)
+    {
+        auto line_break = text.find('\n', std::max(bounds[i - 1], i * text.size() / num_chunks));
+        bounds[i] = line_break == std::string_view::npos ? text.size() : line_break + 1;
+    }
+
+    std::vector<Chunk> chunks(num_chunks);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_chunks; ++i)
+        threads.emplace_back(parse_chunk, text.substr(bounds[i], bounds[i + 1] - bounds[i]), std::ref(chunks[i]));
+    parse_chunk(text.substr(0, bounds[1]), chunks[0]);
+    for (auto &thread : threads)
+        thread.join();
+
+    size_t num_positions = 0, num_corners = 0, num_faces = 0;
+    for (const auto &chunk : chunks)
+    {
+        if (!chunk.is_valid)
+        {
+            mesh.clear();
+            return false;
+        }
+        num_positions += chunk.positions.size();
+        num_corners += chunk.corners.size();
+        num_faces += chunk.face_sizes.size();
+    }
+
+    mesh.clear();
+    mesh.reserve(num_positions, num_corners, num_faces);
+    for (const auto &chunk : chunks)
+        for (const auto &point : chunk.positions)
+            mesh.add_vertex(point);
+
+    // Attributes are only gathered if the mesh stores them
+    std::vector<Mesh::TexCoord2D> texcoords;
+    std::vector<Mesh::Normal> normals;
+    for (const auto &chunk : chunks)
+    {
+        if (mesh.has_vertex_texcoords2D())
+            texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        if (mesh.has_vertex_normals())
+            normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    }
+
+    // Absolute index of an element of any chunk, or -1 if it is out of range
+    auto resolve = [](int index, bool is_relative, size_t base, size_t count) -> long long {
+        if (index == MISSING)
+            return -1;
+        long long absolute = is_relative ? static_cast<long long>(base) + index : index;
+        return absolute >= 0 && absolute < static_cast<long long>(count) ? absolute : -1;
+    };
+
+    // Faces refer to vertices of any chunk, so they are added once all vertices exist.
+    // Per-corner attributes are stored per vertex, the last corner of a vertex wins.
+    std::vector<Mesh::VertexHandle> face;
+    std::vector<std::vector<Mesh::VertexHandle>> failed_faces; // rejected by the mesh as non-manifold
+    size_t position_base = 0, texcoord_base = 0, normal_base = 0;
+    for (const auto &chunk : chunks)
+    {
+        auto corner = chunk.corners.begin();
+        for (auto size : chunk.face_sizes)
+        {
+            face.clear();
+            for (std::uint32_t k = 0; k < size; ++k, ++corner)
+            {
+                auto position =
+                    resolve(corner->position, corner->relative & RELATIVE_POSITION, position_base, num_positions);
+                if (position < 0)
+                {
+                    mesh.clear();
+                    return false;
+                }
+                face.push_back(Mesh::VertexHandle(static_cast<int>(position)));
+
+                auto texcoord =
+                    resolve(corner->texcoord, corner->relative & RELATIVE_TEXCOORD, texcoord_base, texcoords.size());
+                if (texcoord >= 0)
+                    mesh.set_texcoord2D(face.back(), texcoords[texcoord]);
+
+                auto normal = resolve(corner->normal, corner->relative & RELATIVE_NORMAL, normal_base, normals.size());
+                if (normal >= 0)
+                    mesh.set_normal(face.back(), normals[normal]);
+            }
+            if (face.size() >= 3 && !mesh.add_face(face).is_valid())
+                failed_faces.push_back(face);
+        }
+
+        position_base += chunk.positions.size();
+        texcoord_base += chunk.texcoords.size();
+        normal_base += chunk.normals.size();
+    }
+
+    // As read_mesh does, non-manifold faces are added last as isolated faces, on copies of their vertices
+    for (auto &failed_face : failed_faces)
+    {
+        for (auto &v : failed_face)
+        {
+            auto copy = mesh.add_vertex(Mesh::Point(mesh.point(v))); // copied, adding may move the points
+            if (mesh.has_vertex_texcoords2D())
+                mesh.set_texcoord2D(copy, Mesh::TexCoord2D(mesh.texcoord2D(v)));
+            if (mesh.has_vertex_normals())
+                mesh.set_normal(copy, Mesh::Normal(mesh.normal(v)));
+            v = copy;
+        }
+        mesh.add_face(failed_face);
+    }
+
+    return true;
+}
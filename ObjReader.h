@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include "Mesh.h"
+
+// Wavefront OBJ reader for large files. The file is memory-mapped and split into chunks at line boundaries,
+// the chunks are parsed in parallel and the mesh is then built in one pass over the parsed data.
+// Reads v, vn, vt and f lines (polygons are triangulated by the mesh) and skips everything else.
+// Normals and texture coordinates are only stored if the mesh has requested them, as with read_mesh.
+// Faces that would make the mesh non-manifold are also kept like read_mesh does, as isolated faces on duplicates of
+// their vertices.
+class ObjReader
+{
+  public:
+    // Replaces the contents of the mesh, returns false and leaves it empty if the file cannot be read or is malformed.
+    // num_threads = 0 uses all hardware threads
+    static bool read(Mesh &mesh, const std::string &filename, unsigned num_threads = 0);
+};
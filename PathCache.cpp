@@ -0,0 +1,63 @@
+#include "PathCache.h"
+
+#include <algorithm>
+
+PathCache::PathCache(size_t max_vertices) : max_vertices(max_vertices)
+{
+}
+
+PathCache::Key PathCache::make_key(Mesh::VertexHandle source, Mesh::VertexHandle target, std::uint32_t weight_id)
+{
+    return {std::min(source.idx(), target.idx()), std::max(source.idx(), target.idx()), weight_id};
+}
+
+std::optional<std::vector<Mesh::VertexHandle>> PathCache::find(Mesh::VertexHandle source, Mesh::VertexHandle target,
+                                                               std::uint32_t weight_id)
+{
+    auto it = index.find(make_key(source, target, weight_id));
+    if (it == index.end())
+        return std::nullopt;
+
+    entries.splice(entries.begin(), entries, it->second);
+
+    auto path = it->second->path;
+    if (source.idx() != it->first.first)
+        std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void PathCache::insert(Mesh::VertexHandle source, Mesh::VertexHandle target, std::uint32_t weight_id,
+                       std::vector<Mesh::VertexHandle> path)
+{
+    if (path.size() > max_vertices)
+        return;
+
+    auto key = make_key(source, target, weight_id);
+    if (source.idx() != key.first)
+        std::reverse(path.begin(), path.end());
+
+    if (auto it = index.find(key); it != index.end())
+    {
+        num_vertices -= it->second->path.size();
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    num_vertices += path.size();
+    entries.push_front({key, std::move(path)});
+    index[key] = entries.begin();
+
+    while (num_vertices > max_vertices)
+    {
+        num_vertices -= entries.back().path.size();
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+void PathCache::clear()
+{
+    entries.clear();
+    index.clear();
+    num_vertices = 0;
+}
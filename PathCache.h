@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+
+// Least recently used cache of vertex paths, keyed by (source, target, weight id).
+// The weight id tells apart paths computed under different metrics (edge lengths, heat geodesics, ...).
+// Paths are undirected: a path cached from a to b also answers the query from b to a.
+// Memory is bounded by the total number of cached path vertices.
+class PathCache
+{
+  public:
+    explicit PathCache(size_t max_vertices = size_t(1) << 20);
+
+    std::optional<std::vector<Mesh::VertexHandle>> find(Mesh::VertexHandle source, Mesh::VertexHandle target,
+                                                        std::uint32_t weight_id);
+
+    // The path runs from source to target, as returned by Dijkstra::get_path
+    void insert(Mesh::VertexHandle source, Mesh::VertexHandle target, std::uint32_t weight_id,
+                std::vector<Mesh::VertexHandle> path);
+
+    void clear();
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+  private:
+    // Endpoints are stored in increasing order
+    struct Key
+    {
+        int first, second;
+        std::uint32_t weight_id;
+
+        bool operator==(const Key &) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const
+        {
+            auto h = (std::uint64_t(std::uint32_t(key.first)) << 32) | std::uint32_t(key.second);
+            return std::hash<std::uint64_t>()(h * 0x9E3779B97F4A7C15ull ^ key.weight_id);
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        std::vector<Mesh::VertexHandle> path; // from key.first to key.second
+    };
+
+    static Key make_key(Mesh::VertexHandle source, Mesh::VertexHandle target, std::uint32_t weight_id);
+
+    size_t max_vertices;
+    size_t num_vertices = 0;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+};
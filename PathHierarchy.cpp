@@ -0,0 +1,273 @@
+#include "PathHierarchy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+
+#include "DistanceField.h"
+
+namespace
+{
+constexpr char FILE_MAGIC[4] = {'P', 'H', 'Y', '1'};
+
+// Total arc weight of the fine graph, stored in the file to recognize a hierarchy built for other edge weights
+double weight_sum(const MeshGraph &graph)
+{
+    double sum = 0.0;
+    for (const auto &arc : graph.get_arcs())
+        sum += arc.weight;
+    return sum;
+}
+
+// Graph Voronoi cells of seeds spread evenly over the vertex order, and the adjacency graph of the cells
+std::pair<std::vector<int>, MeshGraph> build_levels(const MeshGraph &graph, size_t vertices_per_cell,
+                                                    unsigned num_threads)
+{
+    const size_t n = graph.n_vertices();
+    auto is_isolated = [&](size_t v) {
+        return graph.arcs_begin(static_cast<MeshGraph::Index>(v)) == graph.arcs_end(static_cast<MeshGraph::Index>(v));
+    };
+
+    std::vector<Mesh::VertexHandle> seeds;
+    const size_t num_seeds = std::max<size_t>(1, n / std::max<size_t>(1, vertices_per_cell));
+    for (size_t i = 0; i < num_seeds; ++i)
+    {
+        auto v = i * n / num_seeds;
+        auto end = (i + 1) * n / num_seeds;
+        while (v < end && is_isolated(v))
+            v++;
+        if (v < end)
+            seeds.push_back(Mesh::VertexHandle(static_cast<int>(v)));
+    }
+
+    DistanceField field(graph, seeds, num_threads);
+    const auto &cells = field.get_labels();
+    const auto &distances = field.get_distances();
+
+    // Every arc across a cell border closes a path between the two seeds
+    std::vector<std::tuple<MeshGraph::Index, MeshGraph::Index, double>> borders;
+    for (size_t v = 0; v < n; ++v)
+        graph.for_each_neighbor(static_cast<MeshGraph::Index>(v), [&](int neighbor, double weight) {
+            if (cells[v] != cells[neighbor])
+                borders.emplace_back(cells[v], cells[neighbor], distances[v] + weight + distances[neighbor]);
+        });
+
+    // Keep the shortest crossing of every pair of adjacent cells
+    std::sort(borders.begin(), borders.end());
+    std::vector<MeshGraph::Index> offsets(seeds.size() + 1, 0);
+    std::vector<MeshGraph::Arc> arcs;
+    for (size_t i = 0; i < borders.size(); ++i)
+    {
+        auto [from, to, weight] = borders[i];
+        if (i > 0 && std::get<0>(borders[i - 1]) == from && std::get<1>(borders[i - 1]) == to)
+            continue;
+        arcs.push_back({to, weight});
+        offsets[from + 1]++;
+    }
+    for (size_t i = 1; i < offsets.size(); ++i)
+        offsets[i] += offsets[i - 1];
+
+    return {cells, MeshGraph(std::move(offsets), std::move(arcs))};
+}
+
+template <typename T> void write_value(std::ofstream &file, const T &value)
+{
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> bool read_value(std::ifstream &file, T &value)
+{
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+} // namespace
+
+PathHierarchy::PathHierarchy(const Mesh &mesh, const MeshGraph &graph, size_t vertices_per_cell,
+                             unsigned num_threads)
+    : PathHierarchy(mesh, graph, build_levels(graph, vertices_per_cell, num_threads))
+{
+}
+
+PathHierarchy::PathHierarchy(const Mesh &mesh, const MeshGraph &graph, std::pair<std::vector<int>, MeshGraph> levels)
+    : mesh(mesh), graph(graph), cells(std::move(levels.first)), coarse_graph(std::move(levels.second)),
+      coarse_tree(coarse_graph), coarse_target_tree(coarse_graph), corridor_stamps(graph.n_vertices(), 0),
+      cell_stamps(coarse_graph.n_vertices(), 0)
+{
+    build_cell_vertices();
+}
+
+void PathHierarchy::build_cell_vertices()
+{
+    cell_offsets.assign(coarse_graph.n_vertices() + 1, 0);
+    for (int cell : cells)
+        if (cell != -1)
+            cell_offsets[cell + 1]++;
+    for (size_t i = 1; i < cell_offsets.size(); ++i)
+        cell_offsets[i] += cell_offsets[i - 1];
+
+    auto next = cell_offsets;
+    cell_vertices.resize(cell_offsets.back());
+    for (size_t v = 0; v < cells.size(); ++v)
+        if (cells[v] != -1)
+            cell_vertices[next[cells[v]]++] = static_cast<MeshGraph::Index>(v);
+}
+
+std::unique_ptr<PathHierarchy> PathHierarchy::load(const std::string &filename, const Mesh &mesh,
+                                                   const MeshGraph &graph)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        return nullptr;
+
+    char magic[4];
+    std::uint64_t n_vertices, n_arcs, n_cells, n_coarse_arcs;
+    double fine_weight_sum;
+    if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, FILE_MAGIC) ||
+        !read_value(file, n_vertices) || !read_value(file, n_arcs) || !read_value(file, fine_weight_sum) ||
+        !read_value(file, n_cells) || !read_value(file, n_coarse_arcs))
+        return nullptr;
+
+    if (n_vertices != graph.n_vertices() || n_arcs != graph.n_arcs() || fine_weight_sum != weight_sum(graph))
+        return nullptr;
+
+    // Every cell holds a vertex and every coarse arc crosses a fine one, bounding the sizes before allocating
+    if (n_cells > n_vertices || n_coarse_arcs > n_arcs)
+        return nullptr;
+
+    std::vector<int> cells(n_vertices);
+    std::vector<MeshGraph::Index> offsets(n_cells + 1);
+    std::vector<MeshGraph::Arc> arcs(n_coarse_arcs);
+    file.read(reinterpret_cast<char *>(cells.data()), cells.size() * sizeof(int));
+    file.read(reinterpret_cast<char *>(offsets.data()), offsets.size() * sizeof(MeshGraph::Index));
+    for (auto &arc : arcs)
+        if (!read_value(file, arc.to) || !read_value(file, arc.weight))
+            return nullptr;
+    if (!file)
+        return nullptr;
+
+    // A corrupt file is rejected before any of it is used as an index
+    for (int cell : cells)
+        if (cell < -1 || cell >= static_cast<std::int64_t>(n_cells))
+            return nullptr;
+    if (offsets.front() != 0 || offsets.back() != n_coarse_arcs ||
+        !std::is_sorted(offsets.begin(), offsets.end()))
+        return nullptr;
+    for (const auto &arc : arcs)
+        if (arc.to >= n_cells || !(arc.weight >= 0.0) || !std::isfinite(arc.weight))
+            return nullptr;
+
+    return std::unique_ptr<PathHierarchy>(
+        new PathHierarchy(mesh, graph, {std::move(cells), MeshGraph(std::move(offsets), std::move(arcs))}));
+}
+
+void PathHierarchy::save(const std::string &filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Path hierarchy save failed: could not open " + filename);
+
+    file.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    write_value<std::uint64_t>(file, graph.n_vertices());
+    write_value<std::uint64_t>(file, graph.n_arcs());
+    write_value(file, weight_sum(graph));
+    write_value<std::uint64_t>(file, coarse_graph.n_vertices());
+    write_value<std::uint64_t>(file, coarse_graph.n_arcs());
+
+    const auto &offsets = coarse_graph.get_offsets();
+    file.write(reinterpret_cast<const char *>(cells.data()), cells.size() * sizeof(int));
+    file.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(MeshGraph::Index));
+    for (const auto &arc : coarse_graph.get_arcs())
+    {
+        write_value(file, arc.to);
+        write_value(file, arc.weight);
+    }
+
+    if (!file)
+        throw std::runtime_error("Path hierarchy save failed: could not write " + filename);
+}
+
+PathHierarchy::Path PathHierarchy::find_path(Mesh::VertexHandle source, Mesh::VertexHandle target,
+                                             unsigned corridor_rings, double coarse_slack)
+{
+    auto search = [&](const Dijkstra::Corridor *corridor) {
+        auto dijkstra = Dijkstra::compute(
+            mesh, graph, source, target,
+            Dijkstra::Options(Dijkstra::Mode::A_STAR, &workspace, Dijkstra::Queue::QUATERNARY_HEAP, nullptr, corridor));
+        return Path{dijkstra.get_distance(target), dijkstra.get_path(target)};
+    };
+
+    auto source_cell = get_cell(source);
+    auto target_cell = get_cell(target);
+    if (source_cell == -1 || target_cell == -1)
+    {
+        corridor_size = graph.n_vertices();
+        return search(nullptr);
+    }
+
+    // Cells in different components have no coarse path, and neither have their vertices
+    coarse_tree.reset(Mesh::VertexHandle(source_cell));
+    if (!coarse_tree.has_path(Mesh::VertexHandle(target_cell)))
+    {
+        corridor_size = 0;
+        return Path();
+    }
+
+    // Stamps wrap around after 2^32 queries, at which point the old stamps are cleared
+    if (++stamp == 0)
+    {
+        std::fill(corridor_stamps.begin(), corridor_stamps.end(), 0);
+        std::fill(cell_stamps.begin(), cell_stamps.end(), 0);
+        stamp = 1;
+    }
+
+    // Every cell on a coarse path at most coarse_slack longer than the shortest one, so that the corridor follows
+    // both sides of a feature when their lengths are close, e.g. around a handle or a bump
+    coarse_target_tree.reset(Mesh::VertexHandle(target_cell));
+    double max_distance = (1.0 + coarse_slack) * coarse_tree.get_distance(Mesh::VertexHandle(target_cell));
+    std::vector<MeshGraph::Index> corridor_cells;
+    for (size_t cell = 0; cell < n_cells(); ++cell)
+    {
+        Mesh::VertexHandle handle(static_cast<int>(cell));
+        if (coarse_tree.get_distance(handle) + coarse_target_tree.get_distance(handle) <= max_distance)
+        {
+            cell_stamps[cell] = stamp;
+            corridor_cells.push_back(static_cast<MeshGraph::Index>(cell));
+        }
+    }
+
+    // Then widen it by rings of neighbor cells, and stamp the vertices of all those cells
+    for (unsigned ring = 0, ring_begin = 0; ring < corridor_rings; ++ring)
+    {
+        auto ring_end = static_cast<unsigned>(corridor_cells.size());
+        for (auto i = ring_begin; i < ring_end; ++i)
+            coarse_graph.for_each_neighbor(corridor_cells[i], [&](int neighbor, double) {
+                if (cell_stamps[neighbor] != stamp)
+                {
+                    cell_stamps[neighbor] = stamp;
+                    corridor_cells.push_back(neighbor);
+                }
+            });
+        ring_begin = ring_end;
+    }
+
+    corridor_size = 0;
+    for (auto cell : corridor_cells)
+        for (auto i = cell_offsets[cell]; i < cell_offsets[cell + 1]; ++i)
+        {
+            corridor_stamps[cell_vertices[i]] = stamp;
+            corridor_size++;
+        }
+
+    // The corridor connects the end points through adjacent cells, so the restricted search always succeeds;
+    // the fallback only guards against inconsistent input
+    Dijkstra::Corridor corridor{corridor_stamps, stamp};
+    auto path = search(&corridor);
+    if (path.vertices.empty())
+    {
+        corridor_size = graph.n_vertices();
+        path = search(nullptr);
+    }
+    return path;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Dijkstra.h"
+#include "DijkstraWorkspace.h"
+#include "Mesh.h"
+#include "MeshGraph.h"
+#include "ShortestPathTree.h"
+
+// Two-level graph for approximate shortest paths on large meshes. The fine vertices are clustered into the
+// graph Voronoi cells of evenly spaced seeds, and the cells form a coarse proxy graph. A path is first found
+// between the cells of its end points and then refined by A* restricted to a corridor of fine vertices in the
+// cells along the coarse path and their neighbors. The refined path is exact within the corridor, so it can
+// only be longer than the true shortest path when the latter leaves the corridor.
+class PathHierarchy
+{
+  public:
+    // The mesh and the graph must outlive the hierarchy. num_threads = 0 uses all hardware threads
+    PathHierarchy(const Mesh &mesh, const MeshGraph &graph, size_t vertices_per_cell = 256, unsigned num_threads = 0);
+
+    // The query scratch space refers to the hierarchy itself
+    PathHierarchy(const PathHierarchy &) = delete;
+    PathHierarchy &operator=(const PathHierarchy &) = delete;
+
+    // Reads a hierarchy written by save; returns nothing if the file is missing or was built for another graph
+    static std::unique_ptr<PathHierarchy> load(const std::string &filename, const Mesh &mesh, const MeshGraph &graph);
+    void save(const std::string &filename) const;
+
+    // File of the hierarchy of a mesh, next to its mesh cache
+    static std::string cache_filename(const std::string &source_filename)
+    {
+        return source_filename + ".paths.cache";
+    }
+
+    struct Path
+    {
+        double distance = std::numeric_limits<double>::infinity();
+        std::vector<Mesh::VertexHandle> vertices; // empty if there is no path
+    };
+
+    // Vertices that are not in any cell (in a component without a seed) are searched without a corridor.
+    // The corridor holds the cells of the coarse paths up to coarse_slack longer than the shortest one, widened by
+    // corridor_rings rings of neighbor cells
+    Path find_path(Mesh::VertexHandle source, Mesh::VertexHandle target, unsigned corridor_rings = 1,
+                   double coarse_slack = 0.25);
+
+    size_t n_cells() const
+    {
+        return coarse_graph.n_vertices();
+    }
+
+    // Cell of the vertex, or -1 if it is not in any cell
+    int get_cell(Mesh::VertexHandle vertex) const
+    {
+        return cells[vertex.idx()];
+    }
+
+    // Number of fine vertices in the corridor of the last query
+    size_t get_corridor_size() const
+    {
+        return corridor_size;
+    }
+
+  private:
+    PathHierarchy(const Mesh &mesh, const MeshGraph &graph, std::pair<std::vector<int>, MeshGraph> levels);
+
+    const Mesh &mesh;
+    const MeshGraph &graph;
+
+    std::vector<int> cells;  // cell of every fine vertex
+    MeshGraph coarse_graph;  // cell adjacency, weighted by the shortest seed to seed path across each cell border
+    std::vector<MeshGraph::Index> cell_offsets; // fine vertices of each cell, as rows into cell_vertices
+    std::vector<MeshGraph::Index> cell_vertices;
+
+    // Query scratch space
+    ShortestPathTree coarse_tree;        // from the cell of the source
+    ShortestPathTree coarse_target_tree; // from the cell of the target, the coarse graph is symmetric
+    DijkstraWorkspace workspace;
+    std::vector<std::uint32_t> corridor_stamps;
+    std::vector<std::uint32_t> cell_stamps;
+    std::uint32_t stamp = 0;
+    size_t corridor_size = 0;
+
+    void build_cell_vertices();
+};
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+// Min-priority queues of vertices keyed by non-negative distances, all sharing the same interface:
+//   push(key, vertex), top_key(), pop() -> vertex, empty()
+// Lazy queues keep stale entries around when a vertex is pushed again with a smaller key,
+// the search skips them when they are popped. Indexed queues update the key in place instead.
+
+// Binary heap with lazy deletion (std::priority_queue)
+class BinaryHeap
+{
+  public:
+    static constexpr bool is_indexed = false;
+
+    void push(double key, int vertex)
+    {
+        heap.push({key, vertex});
+    }
+
+    double top_key() const
+    {
+        return heap.top().first;
+    }
+
+    int pop()
+    {
+        int vertex = heap.top().second;
+        heap.pop();
+        return vertex;
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+  private:
+    using Elem = std::pair<double, int>;
+    std::priority_queue<Elem, std::vector<Elem>, std::greater<>> heap;
+};
+
+// Radix heap with lazy deletion, for monotone searches (no key pushed is smaller than the last key popped).
+// Non-negative doubles compare like their bit patterns, so the keys are used as 64-bit integers without
+// quantization. Keys that fall below the last popped key through rounding (e.g. A* with a consistent
+// heuristic) are clamped to it.
+class RadixHeap
+{
+  public:
+    static constexpr bool is_indexed = false;
+
+    void push(double key, int vertex)
+    {
+        auto bits = std::max(std::bit_cast<std::uint64_t>(key), last);
+        buckets[bucket_index(bits)].push_back({bits, vertex});
+        count++;
+    }
+
+    double top_key()
+    {
+        refill();
+        return std::bit_cast<double>(last);
+    }
+
+    int pop()
+    {
+        refill();
+        int vertex = buckets[0].back().second;
+        buckets[0].pop_back();
+        count--;
+        return vertex;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+  private:
+    // Bucket 0 holds keys equal to the last popped key, bucket i keys whose highest bit differing from it is i - 1
+    std::array<std::vector<std::pair<std::uint64_t, int>>, 65> buckets;
+    std::uint64_t last = 0;
+    size_t count = 0;
+
+    size_t bucket_index(std::uint64_t bits) const
+    {
+        return bits == last ? 0 : 64 - std::countl_zero(bits ^ last);
+    }
+
+    // Moves the minimum key to bucket 0 by redistributing the first non-empty bucket
+    void refill()
+    {
+        if (!buckets[0].empty())
+            return;
+
+        size_t i = 1;
+        while (buckets[i].empty())
+            i++;
+
+        last = buckets[i].front().first;
+        for (const auto &[bits, vertex] : buckets[i])
+            last = std::min(last, bits);
+        for (const auto &elem : buckets[i])
+            buckets[bucket_index(elem.first)].push_back(elem);
+        buckets[i].clear();
+    }
+};
+
+// Indexed d-ary heap with decrease-key, each vertex is in the queue at most once.
+// The position of every vertex is kept in a caller-owned array that must hold -1 for all vertices
+// on construction; the entries are restored to -1 when the heap is destroyed.
+template <unsigned Arity> class IndexedHeap
+{
+  public:
+    static constexpr bool is_indexed = true;
+
+    explicit IndexedHeap(std::vector<std::int32_t> &positions) : positions(positions)
+    {
+    }
+
+    ~IndexedHeap()
+    {
+        for (const auto &elem : heap)
+            positions[elem.vertex] = -1;
+    }
+
+    IndexedHeap(const IndexedHeap &) = delete;
+    IndexedHeap &operator=(const IndexedHeap &) = delete;
+
+    // Inserts the vertex, or lowers its key if it is already in the queue
+    void push(double key, int vertex)
+    {
+        auto position = positions[vertex];
+        if (position == -1)
+        {
+            position = static_cast<std::int32_t>(heap.size());
+            heap.push_back({key, vertex});
+        }
+        else if (key < heap[position].key)
+            heap[position].key = key;
+        else
+            return;
+        sift_up(position);
+    }
+
+    double top_key() const
+    {
+        return heap.front().key;
+    }
+
+    int pop()
+    {
+        int vertex = heap.front().vertex;
+        positions[vertex] = -1;
+        if (heap.size() > 1)
+        {
+            heap.front() = heap.back();
+            heap.pop_back();
+            sift_down(0);
+        }
+        else
+            heap.pop_back();
+        return vertex;
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+  private:
+    struct Elem
+    {
+        double key;
+        int vertex;
+    };
+
+    // Signed like the heap positions, mixing it with them in unsigned arithmetic would wrap around
+    static constexpr std::int32_t ARITY = static_cast<std::int32_t>(Arity);
+
+    std::vector<Elem> heap;
+    std::vector<std::int32_t> &positions;
+
+    void sift_up(std::int32_t position)
+    {
+        auto elem = heap[position];
+        while (position > 0)
+        {
+            auto parent = (position - 1) / ARITY;
+            if (heap[parent].key <= elem.key)
+                break;
+            heap[position] = heap[parent];
+            positions[heap[position].vertex] = position;
+            position = parent;
+        }
+        heap[position] = elem;
+        positions[elem.vertex] = position;
+    }
+
+    void sift_down(std::int32_t position)
+    {
+        auto elem = heap[position];
+        auto size = static_cast<std::int32_t>(heap.size());
+        while (true)
+        {
+            auto first_child = position * ARITY + 1;
+            if (first_child >= size)
+                break;
+
+            auto last_child = std::min(first_child + ARITY, size);
+            auto min_child = first_child;
+            for (auto child = first_child + 1; child < last_child; ++child)
+                if (heap[child].key < heap[min_child].key)
+                    min_child = child;
+
+            if (elem.key <= heap[min_child].key)
+                break;
+            heap[position] = heap[min_child];
+            positions[heap[position].vertex] = position;
+            position = min_child;
+        }
+        heap[position] = elem;
+        positions[elem.vertex] = position;
+    }
+};
+
+using QuaternaryHeap = IndexedHeap<4>;
@@ -0,0 +1,92 @@
+#include "ShortestPathTree.h"
+
+#include <algorithm>
+
+ShortestPathTree::ShortestPathTree(const MeshGraph &graph) : graph(graph)
+{
+}
+
+void ShortestPathTree::reset(Mesh::VertexHandle source)
+{
+    this->source = source;
+    num_settled = 0;
+
+    // The old queue restores its positions before the labels are reset
+    queue.reset();
+    workspace.begin_query(graph.n_vertices());
+    if (!source.is_valid())
+        return;
+
+    auto &labels = workspace.forward;
+    queue.emplace(labels.queue_positions());
+    labels.set(source.idx(), 0.0, -1);
+    queue->push(0.0, source.idx());
+}
+
+bool ShortestPathTree::is_settled(Mesh::VertexHandle vertex) const
+{
+    return source.is_valid() && workspace.forward.is_settled(vertex.idx());
+}
+
+void ShortestPathTree::grow(size_t n_vertices)
+{
+    if (!source.is_valid())
+        return;
+
+    for (size_t i = 0; i < n_vertices && !queue->empty(); ++i)
+        settle(queue->pop());
+}
+
+bool ShortestPathTree::has_path(Mesh::VertexHandle vertex)
+{
+    return get_distance(vertex) != std::numeric_limits<double>::infinity();
+}
+
+double ShortestPathTree::get_distance(Mesh::VertexHandle vertex)
+{
+    if (!source.is_valid())
+        return std::numeric_limits<double>::infinity();
+
+    grow_until_settled(vertex.idx());
+    return workspace.forward.distance(vertex.idx());
+}
+
+std::vector<Mesh::VertexHandle> ShortestPathTree::get_path(Mesh::VertexHandle vertex)
+{
+    if (!has_path(vertex))
+        return {};
+
+    std::vector<Mesh::VertexHandle> path;
+    for (int v = vertex.idx(); v != -1; v = workspace.forward.previous(v))
+        path.push_back(Mesh::VertexHandle(v));
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void ShortestPathTree::grow_until_settled(int vertex)
+{
+    auto &labels = workspace.forward;
+
+    while (!labels.is_settled(vertex) && !queue->empty())
+        settle(queue->pop());
+}
+
+void ShortestPathTree::settle(int vertex)
+{
+    auto &labels = workspace.forward;
+    labels.settle(vertex);
+    num_settled++;
+
+    auto dist = labels.distance(vertex);
+    graph.for_each_neighbor(vertex, [&](int neighbor, double weight) {
+        if (labels.is_settled(neighbor))
+            return;
+
+        auto new_dist = dist + weight;
+        if (new_dist < labels.distance(neighbor))
+        {
+            labels.set(neighbor, new_dist, vertex);
+            queue->push(new_dist, neighbor);
+        }
+    });
+}
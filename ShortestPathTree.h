@@ -0,0 +1,59 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "DijkstraWorkspace.h"
+#include "Mesh.h"
+#include "MeshGraph.h"
+#include "PriorityQueue.h"
+
+// Single-source shortest path tree that is grown on demand: a query only settles the vertices closer to
+// the source than its target, and later queries from the same source reuse everything settled so far.
+// Meant for many targets from one source, e.g. hover previews from the last vertex of a seam.
+class ShortestPathTree
+{
+  public:
+    // The graph must outlive the tree
+    explicit ShortestPathTree(const MeshGraph &graph);
+
+    // The queue refers into the workspace, so the tree stays where it was built
+    ShortestPathTree(const ShortestPathTree &) = delete;
+    ShortestPathTree &operator=(const ShortestPathTree &) = delete;
+
+    // Discards the tree and restarts it from the given source
+    void reset(Mesh::VertexHandle source);
+
+    Mesh::VertexHandle get_source() const
+    {
+        return source;
+    }
+
+    // Whether the tree already reaches the vertex, so that the queries below answer without growing it
+    bool is_settled(Mesh::VertexHandle vertex) const;
+    // Settles up to the given number of further vertices, closest first
+    void grow(size_t n_vertices);
+
+    // The queries grow the tree until the vertex is settled
+    bool has_path(Mesh::VertexHandle vertex);
+    double get_distance(Mesh::VertexHandle vertex);
+    std::vector<Mesh::VertexHandle> get_path(Mesh::VertexHandle vertex);
+
+    // Number of vertices settled since the last reset
+    size_t get_num_settled() const
+    {
+        return num_settled;
+    }
+
+  private:
+    const MeshGraph &graph;
+    DijkstraWorkspace workspace;
+    std::optional<QuaternaryHeap> queue;
+
+    Mesh::VertexHandle source;
+    size_t num_settled = 0;
+
+    void grow_until_settled(int vertex);
+    // Settles the vertex popped from the queue and relaxes its arcs
+    void settle(int vertex);
+};
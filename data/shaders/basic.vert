@@ -5,8 +5,12 @@ layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 tex_coords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
 
 void main()
 {
@@ -5,16 +5,32 @@ layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 tex_coords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+uniform bool octahedral_normals; // normal holds the two components of an octahedral encoding
 
 out vec3 FragPos;
 out vec3 Normal;
 
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
+    vec3 n = octahedral_normals ? decode_octahedral(normal.xy) : normal;
+
     FragPos = vec3(model * vec4(position, 1.0));
-    Normal = mat3(transpose(inverse(model))) * normal;
+    Normal = mat3(transpose(inverse(model))) * n;
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
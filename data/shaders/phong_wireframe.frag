@@ -0,0 +1,41 @@
+#version 330 core
+
+in vec3 FragPosition;
+in vec3 FragNormal;
+noperspective in vec3 EdgeDistance;
+
+out vec4 FragColor;
+
+uniform vec4 color;
+uniform vec3 light_pos;
+uniform vec3 light_color;
+uniform vec3 view_pos;
+uniform vec4 wireframe_color;
+uniform float line_width; // in pixels
+
+void main()
+{
+    // ambient
+    float ambientStrength = 0.9;
+    vec3 ambient = ambientStrength * light_color;
+
+    // diffuse
+    vec3 norm = normalize(FragNormal);
+    vec3 lightDir = normalize(light_pos - FragPosition);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * light_color;
+
+    // specular
+    float specular_strength = 0.3;
+    vec3 viewDir = normalize(view_pos - FragPosition);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specular_strength * spec * light_color;
+
+    vec3 result = (ambient + diffuse + specular) * vec3(color);
+
+    // edges over the surface, their border blended over a pixel
+    float edge_distance = min(EdgeDistance.x, min(EdgeDistance.y, EdgeDistance.z));
+    float edge = 1.0 - smoothstep(0.5 * line_width - 0.5, 0.5 * line_width + 0.5, edge_distance);
+    FragColor = mix(vec4(result, color.a), wireframe_color, edge);
+}
\ No newline at end of file
@@ -1,7 +1,7 @@
 #version 330 core
 
 flat in int vertexId;
-out vec4 FragColor;
+out uint FragId;
 
 void main()
 {
@@ -9,5 +9,5 @@ void main()
     if (radius > 0.5)
         discard;
 
-    FragColor = vec4(float(vertexId & 255), float((vertexId >> 8) & 255), float((vertexId >> 16) & 255), 255.0) / 255.0;
+    FragId = uint(vertexId);
 }
\ No newline at end of file
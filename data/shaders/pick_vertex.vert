@@ -5,8 +5,12 @@ layout(location = 0) in vec3 position;
 flat out int vertexId;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
 
 void main()
 {
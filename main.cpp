@@ -1,13 +1,28 @@
-#include <OpenMesh/Core/IO/MeshIO.hh>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
 
 #include "Dijkstra.h"
+#include "DistanceField.h"
+#include "HeatGeodesic.h"
+#include "Landmarks.h"
 #include "Mesh.h"
-#include "MeshToGL.h"
+#include "MeshGraph.h"
+#include "MeshLoader.h"
+#include "PathCache.h"
+#include "PathHierarchy.h"
+#include "ShortestPathTree.h"
 
 #include "MyGL/LogConsole.h"
 #include "MyGL/Mesh.h"
+#include "MyGL/MeshBVH.h"
+#include "MyGL/MeshClusters.h"
+#include "MyGL/MeshLods.h"
 #include "MyGL/PickVertex.h"
+#include "MyGL/SelectRegion.h"
 #include "MyGL/Shader.h"
+#include "MyGL/ShaderLibrary.h"
 #include "MyGL/Utils.h"
 #include "MyGL/Window.h"
 
@@ -20,7 +35,14 @@ struct Flags
     } draw_mode = InteractionMode::DEFAULT;
 
     bool draw_wireframe = true;
+    float wireframe_width = 1.0f; // in pixels
     bool show_log_console = false;
+    bool smooth_seams = false; // trace seams along heat method geodesics instead of shortest edge paths
+    bool cull_backfaces = false; // only for closed meshes, the back faces of open ones show through their holes
+    bool use_lods = true;
+    float lod_pixel_error = 1.0f; // largest error of the drawn level of detail on screen
+    bool lasso_selection = false; // the right mouse button drags a lasso instead of a box
+    bool select_see_through = false; // also select the vertices hidden by the mesh
 } flags;
 
 const char *InteractionModeItems[] = {"Default", "Select Vertex"};
@@ -37,6 +59,12 @@ class StatusBar
         this->text = text;
     }
 
+    // Shows a progress bar in front of the text, a negative fraction hides it
+    void set_progress(float fraction)
+    {
+        progress = fraction;
+    }
+
     void draw()
     {
         ImGuiViewport *viewport = ImGui::GetMainViewport();
@@ -48,6 +76,11 @@ class StatusBar
         {
             float textHeight = ImGui::GetTextLineHeight();
             ImGui::SetCursorPosY((30 - textHeight) * 0.5f);
+            if (progress >= 0.0f)
+            {
+                ImGui::ProgressBar(progress, ImVec2(200.0f, textHeight), "");
+                ImGui::SameLine();
+            }
             ImGui::Text("%s", text.c_str());
         }
         ImGui::End();
@@ -55,6 +88,7 @@ class StatusBar
 
   private:
     std::string text;
+    float progress = -1.0f;
 } status_bar("no message");
 
 MyGL::LogConsole logger;
@@ -64,12 +98,53 @@ MyGL::LogConsole logger;
 class SelectSeam
 {
   public:
-    SelectSeam(const Mesh &mesh) : mesh(mesh), gl_selected_vertices({glm::vec3(0.0f)})
+    // The graph is the adjacency snapshot of the mesh, the landmarks and the path hierarchy (null for small meshes)
+    // are computed on it, all by the loader
+    SelectSeam(const Mesh &mesh, std::unique_ptr<const MeshGraph> graph, Landmarks landmarks,
+               std::unique_ptr<PathHierarchy> path_hierarchy)
+        : mesh(mesh), graph(std::move(graph)), landmarks(std::move(landmarks)),
+          path_hierarchy(std::move(path_hierarchy)), tree(*this->graph), gl_selected_vertices({glm::vec3(0.0f)}),
+          gl_preview_vertices({glm::vec3(0.0f)})
     {
     }
 
+    // Called every frame. The heat geodesics are factored on a worker thread once smooth seams are first enabled,
+    // which takes long on large meshes and is not worth it for the edge paths. Smooth seams use edge paths until
+    // the factorization is ready, and for good if it fails
+    void update_heat_geodesic()
+    {
+        if (!heat_geodesic_job.valid())
+        {
+            if (flags.smooth_seams && !heat_geodesic && !heat_geodesic_failed)
+            {
+                logger.log("Factoring heat geodesics, seams follow edge paths until they are ready");
+                heat_geodesic_start_time = std::chrono::steady_clock::now();
+                heat_geodesic_job = std::async(std::launch::async,
+                                               [&mesh = mesh] { return std::make_unique<HeatGeodesic>(mesh); });
+            }
+            return;
+        }
+
+        if (heat_geodesic_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        try
+        {
+            heat_geodesic = heat_geodesic_job.get();
+            std::chrono::duration<double, std::milli> time =
+                std::chrono::steady_clock::now() - heat_geodesic_start_time;
+            logger.log("Heat geodesics factored in {:.0f} ms", time.count());
+        }
+        catch (const std::exception &e)
+        {
+            logger.log(e.what());
+            heat_geodesic_failed = true;
+        }
+    }
+
     void add_vertex(Mesh::VertexHandle new_vertex)
     {
+        auto segment_start = selected_vertices.size();
+
         if (is_closed())
         {
             // The path is already closed
@@ -81,20 +156,72 @@ class SelectSeam
             if (mesh.is_boundary(new_vertex))
                 // The first vertex should be on the boundary
                 selected_vertices.push_back(new_vertex);
+            else
+            {
+                // Otherwise start from the nearest boundary vertex and walk to the clicked one
+                if (!boundary_field)
+                    boundary_field.emplace(*graph, DistanceField::boundary_vertices(mesh));
+                auto start = boundary_field->get_nearest_source(new_vertex);
+                if (start.is_valid())
+                {
+                    selected_vertices.push_back(start);
+                    append_path(new_vertex);
+                }
+            }
             update_gl_selected_vertices();
         }
         else
         {
             // Add the new vertex to the path
-            auto last_vertex = selected_vertices.back();
-            Dijkstra dijkstra = Dijkstra::compute(mesh, last_vertex, new_vertex);
-            if (dijkstra.has_path(new_vertex))
-            {
-                auto path = dijkstra.get_path(new_vertex);
-                selected_vertices.insert(selected_vertices.end(), path.begin(), path.end());
-            }
+            append_path(new_vertex);
             update_gl_selected_vertices();
         }
+
+        if (selected_vertices.size() != segment_start)
+            segment_starts.push_back(segment_start);
+    }
+
+    // Removes the segment added by the last click
+    void undo()
+    {
+        if (segment_starts.empty())
+            return;
+
+        selected_vertices.resize(segment_starts.back());
+        segment_starts.pop_back();
+        update_gl_selected_vertices();
+    }
+
+    // Shows the segment a click on the hovered vertex would add, searched again whenever the hovered vertex
+    // or the last selected vertex changes. A vertex the shortest path tree from the last vertex already reaches
+    // is answered from it, any other by an A* search with the landmarks, after which the tree grows by as many
+    // vertices as that search settled. Hovers near the last vertex thus become lookups while the cost of a far one
+    // stays bounded by twice its A* search. Large meshes search their path hierarchy every time
+    void preview(Mesh::VertexHandle hovered_vertex)
+    {
+        auto last_vertex = selected_vertices.empty() || is_closed() ? Mesh::VertexHandle() : selected_vertices.back();
+        if (!last_vertex.is_valid())
+            hovered_vertex = Mesh::VertexHandle();
+        if (hovered_vertex == preview_target && last_vertex == preview_source)
+            return;
+
+        if (!hovered_vertex.is_valid())
+            preview_path.clear();
+        else if (path_hierarchy)
+            preview_path = path_hierarchy->find_path(last_vertex, hovered_vertex).vertices;
+        else if (tree.get_source() == last_vertex && tree.is_settled(hovered_vertex))
+            preview_path = tree.get_path(hovered_vertex);
+        else
+        {
+            if (tree.get_source() != last_vertex)
+                tree.reset(last_vertex);
+            Dijkstra dijkstra = landmark_search(last_vertex, hovered_vertex);
+            preview_path = dijkstra.get_path(hovered_vertex);
+            tree.grow(dijkstra.get_num_settled());
+        }
+        preview_source = last_vertex;
+        preview_target = hovered_vertex;
+        update_gl_points(gl_preview_vertices, preview_path);
     }
 
     bool is_closed() const
@@ -102,88 +229,203 @@ class SelectSeam
         return selected_vertices.size() > 1 && mesh.is_boundary(selected_vertices.back());
     }
 
-    void draw(const std::tuple<glm::mat4, glm::mat4, glm::mat4> &mvp) const
+    void draw(const glm::mat4 &model) const
     {
         if (selected_vertices.size() > 0)
         {
-            basic_shader.use();
-            basic_shader.set_MVP(mvp);
-            basic_shader.set_uniform("color", color);
+            basic_shader->use();
+            basic_shader->set_model(model);
+            basic_shader->set_uniform("color", color);
             gl_selected_vertices.draw();
         }
+
+        if (preview_path.size() > 0)
+        {
+            basic_shader->use();
+            basic_shader->set_model(model);
+            basic_shader->set_uniform("color", preview_color);
+            gl_preview_vertices.draw();
+        }
     }
 
   private:
+    // Ids of the metrics seam segments are traced in, for the path cache
+    enum PathMetric : std::uint32_t
+    {
+        EDGE_LENGTH,
+        HEAT_GEODESIC
+    };
+
+    // Extends the path from its last vertex to the given vertex,
+    // along the shortest edge path or, with smooth seams enabled, along the heat method geodesic
+    void append_path(Mesh::VertexHandle new_vertex)
+    {
+        auto last_vertex = selected_vertices.back();
+
+        std::vector<Mesh::VertexHandle> path;
+        if (flags.smooth_seams)
+            path = cached_path(last_vertex, new_vertex, HEAT_GEODESIC);
+        if (path.empty())
+            path = cached_path(last_vertex, new_vertex, EDGE_LENGTH);
+
+        selected_vertices.insert(selected_vertices.end(), path.begin(), path.end());
+    }
+
+    // Path in the metric from the cache, or traced and cached under that metric. Empty if the trace failed
+    std::vector<Mesh::VertexHandle> cached_path(Mesh::VertexHandle from, Mesh::VertexHandle to, PathMetric metric)
+    {
+        if (auto path = path_cache.find(from, to, metric))
+            return *path;
+
+        auto path = metric == HEAT_GEODESIC ? heat_path(from, to) : edge_path(from, to);
+        if (!path.empty())
+            path_cache.insert(from, to, metric, path);
+        return path;
+    }
+
+    std::vector<Mesh::VertexHandle> edge_path(Mesh::VertexHandle from, Mesh::VertexHandle to)
+    {
+        // The clicked vertex has usually been previewed already
+        if (from == preview_source && to == preview_target)
+            return preview_path;
+
+        // On large meshes, within a few percent of the shortest path but searching a corridor only
+        if (path_hierarchy)
+        {
+            auto path = path_hierarchy->find_path(from, to).vertices;
+            logger.log("Seam segment: {} vertices in the corridor", path_hierarchy->get_corridor_size());
+            return path;
+        }
+
+        Dijkstra dijkstra = landmark_search(from, to);
+        logger.log("Seam segment: {} vertices settled", dijkstra.get_num_settled());
+        return dijkstra.get_path(to);
+    }
+
+    Dijkstra landmark_search(Mesh::VertexHandle from, Mesh::VertexHandle to)
+    {
+        return Dijkstra::compute(
+            mesh, *graph, from, to,
+            Dijkstra::Options(Dijkstra::Mode::A_STAR, &workspace, Dijkstra::Queue::QUATERNARY_HEAP, &landmarks));
+    }
+
+    std::vector<Mesh::VertexHandle> heat_path(Mesh::VertexHandle from, Mesh::VertexHandle to)
+    {
+        if (!heat_geodesic)
+            return {};
+        heat_geodesic->compute(from);
+
+        auto path = heat_geodesic->get_path(to);
+        if (path.empty())
+            logger.log("Seam segment: heat geodesic trace failed, using the shortest edge path");
+        return path;
+    }
+
     void update_gl_selected_vertices()
+    {
+        update_gl_points(gl_selected_vertices, selected_vertices);
+    }
+
+    void update_gl_points(MyGL::PointCloud &gl_points, const std::vector<Mesh::VertexHandle> &vertices_to_draw)
     {
         std::vector<glm::vec3> vertices;
-        vertices.reserve(selected_vertices.size());
-        for (const auto &v : selected_vertices)
+        vertices.reserve(vertices_to_draw.size());
+        for (const auto &v : vertices_to_draw)
         {
             auto point = mesh.point(v);
             vertices.emplace_back(point[0], point[1], point[2]);
         }
-        gl_selected_vertices.update(vertices);
+        gl_points.update(vertices);
     }
 
     const Mesh &mesh;
+    // Adjacency snapshot, the mesh topology does not change while selecting. The path hierarchy refers to it
+    const std::unique_ptr<const MeshGraph> graph;
+    const Landmarks landmarks; // lower bounds for the A* searches of previews and seam segments
+    std::unique_ptr<PathHierarchy> path_hierarchy;
+    ShortestPathTree tree; // from the last vertex, grown along with the A* searches of the previews
+    std::unique_ptr<HeatGeodesic> heat_geodesic; // null until the worker has factored it
+    std::future<std::unique_ptr<HeatGeodesic>> heat_geodesic_job; // waited for on destruction
+    std::chrono::steady_clock::time_point heat_geodesic_start_time;
+    bool heat_geodesic_failed = false;
+    DijkstraWorkspace workspace;
+    PathCache path_cache;
+    std::optional<DistanceField> boundary_field; // computed on the first click away from the boundary
+
     std::vector<Mesh::VertexHandle> selected_vertices;
+    std::vector<size_t> segment_starts; // index of the first vertex added by each click, for undo
     MyGL::PointCloud gl_selected_vertices;
 
-    MyGL::ShaderProgram basic_shader{MyGL::read_file_to_string("data/shaders/basic.vert"),
-                                     MyGL::read_file_to_string("data/shaders/round_point.frag")};
+    Mesh::VertexHandle preview_source;
+    Mesh::VertexHandle preview_target;
+    std::vector<Mesh::VertexHandle> preview_path;
+    MyGL::PointCloud gl_preview_vertices;
+
+    std::shared_ptr<const MyGL::ShaderProgram> basic_shader =
+        MyGL::ShaderLibrary::get("data/shaders/basic.vert", "data/shaders/round_point.frag");
 
     glm::vec4 color{0.7f, 0.2f, 0.6f, 1.0f};
+    glm::vec4 preview_color{0.9f, 0.6f, 0.85f, 1.0f};
 };
 
+// Faces of the mesh with all their vertices selected, from a selection of GL vertices
+MyGL::SelectionBitset select_faces(const Mesh &mesh, const MyGL::SelectionBitset &gl_vertices,
+                                   const std::vector<GLuint> &vertex_ids)
+{
+    MyGL::SelectionBitset vertices;
+    vertices.reset(mesh.n_vertices());
+    gl_vertices.for_each([&](size_t v) { vertices.set(vertex_ids.empty() ? v : vertex_ids[v]); });
+
+    MyGL::SelectionBitset faces;
+    faces.reset(mesh.n_faces());
+    for (const auto &f : mesh.faces())
+    {
+        bool is_selected = true;
+        for (const auto &v : mesh.fv_range(f))
+            is_selected = is_selected && vertices.test(v.idx());
+        if (is_selected)
+            faces.set(f.idx());
+    }
+    return faces;
+}
+
 // ==================================================
 
 int main()
 {
+    auto start_time = std::chrono::steady_clock::now();
     try
     {
         // Initialize window (and OpenGL context)
         MyGL::Window window;
 
-        // Shaders
-        MyGL::ShaderProgram basic_shader(MyGL::read_file_to_string("data/shaders/basic.vert"),
-                                         MyGL::read_file_to_string("data/shaders/basic.frag"));
-        MyGL::ShaderProgram phong_shader(MyGL::read_file_to_string("data/shaders/phong.vert"),
-                                         MyGL::read_file_to_string("data/shaders/phong.frag"));
+        // Shaders, shared with the other users of the same sources and loaded from their binaries after the first
+        // launch. The wireframe is drawn over the shaded surface in the same pass
+        auto phong_shader = MyGL::ShaderLibrary::get("data/shaders/phong.vert", "data/shaders/phong.frag");
+        auto phong_wireframe_shader = MyGL::ShaderLibrary::get(
+            "data/shaders/phong.vert", "data/shaders/phong_wireframe.frag", "data/shaders/wireframe.geom");
+        MyGL::CameraUniforms camera_uniforms; // view and projection of all shaders
         MyGL::PickVertex pick_vertex;
+        MyGL::SelectRegion select_region;
 
-        // Load mesh from file
+        // Load mesh in the background, from its binary cache if that is up to date, otherwise from the file.
+        // The geometry is drawn as it arrives, interaction starts once the topology is complete
+        const std::string model_filename = "data/models/camelhead.obj";
         Mesh mesh;
-        if (!OpenMesh::IO::read_mesh(mesh, "data/models/camelhead.obj"))
-            throw std::runtime_error("Failed to read mesh from file");
-
-        SelectSeam select_seam_0(mesh);
-
-        // Move mesh to [-1, 1]^3
-        glm::mat4 model; // for convenience, we represent translation of models in the model matrix
-        Eigen::Vector3d min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
-        Eigen::Vector3d max = Eigen::Vector3d::Constant(std::numeric_limits<double>::min());
-
-        for (const auto &v : mesh.vertices())
-        {
-            const auto &point = mesh.point(v);
-            min = min.cwiseMin(point);
-            max = max.cwiseMax(point);
-        }
-
-        Eigen::Vector3d center = (min + max) / 2.0;
-        const auto scale = 2.0 / (max - min).maxCoeff();
-        model = glm::scale(glm::mat4(1.0f), glm::vec3(scale)) *
-                glm::translate(glm::mat4(1.0f), glm::vec3(-center[0], -center[1], -center[2]));
-
-        // Compute normals (for Phong shading)
         mesh.request_face_normals();
         mesh.request_vertex_normals();
-        mesh.update_normals();
+        auto loader = std::make_unique<MeshLoader>(model_filename, mesh);
 
-        // Convert mesh to MyGL::Mesh
-        MeshToGL mesh2gl;
-        MyGL::Mesh gl_mesh(mesh2gl.vertices(mesh), mesh2gl.indices(mesh));
+        glm::mat4 model; // for convenience, we represent translation of models in the model matrix
+        std::optional<MyGL::Mesh> gl_mesh;
+        std::vector<GLuint> mesh_vertex_ids; // mesh vertex of each GL vertex, empty if they are the same
+        MyGL::MeshClusters mesh_clusters;    // empty while loading, everything uploaded is drawn meanwhile
+        MyGL::MeshLods mesh_lods;            // picking and seams always use the full resolution
+        MyGL::MeshBVH mesh_bvh;              // for picking on the CPU
+        size_t drawn_lod = 0;
+        std::optional<SelectSeam> select_seam_0;
+        std::vector<glm::vec2> region_points; // of the region being dragged, in ImGui coordinates
+        MyGL::SelectionBitset selected_faces;
 
         // Set up camera
         // the camera looks at the origin and is positioned at (0, 0, -2) in the beginning
@@ -193,6 +435,7 @@ int main()
         // Render loop
         float last_frame_time = 0.0f;
         float delta_time = 0.0f;
+        bool is_first_frame = true;
         auto io = ImGui::GetIO();
 
         while (!window.should_close())
@@ -212,24 +455,116 @@ int main()
             glm::mat4 view = camera.get_view_matrix() * camera.get_model_matrix();
             auto [width, height] = window.get_framebuffer_size();
             glm::mat4 projection = camera.get_projection_matrix(static_cast<float>(width) / height);
+            camera_uniforms.update(view, projection);
+
+            // Load mesh
+            // ==================================================
+            if (loader)
+            {
+                bool is_finished = loader->is_finished();
+                if (is_finished && !loader->get_error().empty())
+                    throw std::runtime_error(loader->get_error());
+
+                if (!gl_mesh)
+                    if (auto layout = loader->get_layout())
+                    {
+                        // Move mesh to [-1, 1]^3
+                        Eigen::Vector3d center = (layout->bbox_min + layout->bbox_max) / 2.0;
+                        const auto scale = 2.0 / (layout->bbox_max - layout->bbox_min).maxCoeff();
+                        model = glm::scale(glm::mat4(1.0f), glm::vec3(scale)) *
+                                glm::translate(glm::mat4(1.0f), glm::vec3(-center[0], -center[1], -center[2]));
+
+                        gl_mesh.emplace(layout->vertex_format, layout->n_vertices, layout->n_indices,
+                                        layout->quantization.get_position_transform());
+                    }
+                bool is_uploaded = gl_mesh && loader->upload(*gl_mesh);
+                for (const auto &message : loader->take_messages())
+                    logger.log(message);
+
+                if (is_finished && is_uploaded)
+                {
+                    select_seam_0.emplace(mesh, loader->take_graph(), loader->take_landmarks(),
+                                          loader->take_path_hierarchy());
+                    mesh_vertex_ids = loader->take_vertex_ids();
+                    mesh_clusters = loader->take_clusters();
+                    mesh_lods = loader->take_lods();
+                    mesh_bvh = loader->take_bvh();
+                    loader.reset();
+                    status_bar.set_progress(-1.0f);
+                }
+                else
+                {
+                    status_bar.set_text("Loading " + model_filename + ": " + loader->get_status());
+                    status_bar.set_progress(loader->get_progress());
+                }
+            }
 
             // Select vertex
             // ==================================================
-            if (window.is_mouse_inside() && !ImGui::GetIO().WantCaptureMouse)
+            // While loading, before the BVH exists, the ID buffer picks among the triangles uploaded so far and the
+            // hovered vertex is only highlighted
+            if (gl_mesh && window.is_mouse_inside() && !ImGui::GetIO().WantCaptureMouse)
             {
                 ImVec2 mouse_pos = ImGui::GetMousePos();
                 auto [width, height] = MyGL::get_viewport_size();
-                pick_vertex.pick({mouse_pos.x, height - mouse_pos.y}, gl_mesh, {model, view, projection});
+                glm::ivec2 pixel(mouse_pos.x, height - mouse_pos.y);
+                if (mesh_bvh.empty())
+                    pick_vertex.pick(pixel, *gl_mesh, {model, view, projection});
+                else
+                    pick_vertex.pick(pixel, {width, height}, mesh_bvh, {model, view, projection});
             }
 
-            auto hovered_vertex = Mesh::VertexHandle(pick_vertex.get_picked_vertex());
-            if (hovered_vertex.is_valid())
-                status_bar.set_text("Hovered vertex: " + std::to_string(hovered_vertex.idx()));
-            else
-                status_bar.set_text("No vertex hovered");
+            if (select_seam_0)
+            {
+                // Picking returns GL vertices, the buffers may be in a different order than the mesh
+                int picked_vertex = pick_vertex.get_picked_vertex();
+                if (picked_vertex >= 0 && !mesh_vertex_ids.empty())
+                    picked_vertex = static_cast<int>(mesh_vertex_ids[picked_vertex]);
+                auto hovered_vertex = Mesh::VertexHandle(picked_vertex);
+                if (hovered_vertex.is_valid())
+                    status_bar.set_text("Hovered vertex: " + std::to_string(hovered_vertex.idx()));
+                else
+                    status_bar.set_text("No vertex hovered");
+
+                select_seam_0->update_heat_geodesic();
+                if (ImGui::IsMouseClicked(0) && hovered_vertex.is_valid())
+                    select_seam_0->add_vertex(hovered_vertex);
+                select_seam_0->preview(hovered_vertex);
+            }
 
-            if (ImGui::IsMouseClicked(0) && hovered_vertex.is_valid())
-                select_seam_0.add_vertex(hovered_vertex);
+            // Select region
+            // ==================================================
+            if (!mesh_bvh.empty())
+            {
+                ImVec2 mouse_pos = ImGui::GetMousePos();
+                glm::vec2 mouse(mouse_pos.x, mouse_pos.y);
+                if (ImGui::IsMouseClicked(1) && window.is_mouse_inside() && !ImGui::GetIO().WantCaptureMouse)
+                    region_points = {mouse};
+                else if (!region_points.empty() && ImGui::IsMouseDown(1))
+                {
+                    // A box keeps its corners, a lasso the points of the drag a few pixels apart
+                    if (!flags.lasso_selection)
+                        region_points = {region_points.front(), mouse};
+                    else if (glm::distance(region_points.back(), mouse) >= 2.0f)
+                        region_points.push_back(mouse);
+                }
+                else if (!region_points.empty())
+                {
+                    // Window coordinates have their origin at the bottom left, Shift adds to the selection
+                    auto [width, height] = MyGL::get_viewport_size();
+                    auto polygon = flags.lasso_selection
+                                       ? region_points
+                                       : MyGL::SelectRegion::box(region_points.front(), region_points.back());
+                    for (auto &point : polygon)
+                        point.y = height - point.y;
+                    select_region.select(polygon, *gl_mesh, mesh_bvh, {model, view, projection},
+                                         flags.select_see_through ? MyGL::SelectRegion::Mode::SEE_THROUGH
+                                                                  : MyGL::SelectRegion::Mode::VISIBLE,
+                                         ImGui::GetIO().KeyShift);
+                    selected_faces = select_faces(mesh, select_region.get_selection(), mesh_vertex_ids);
+                    region_points.clear();
+                }
+            }
 
             // ImGUI
             // ==================================================
@@ -239,8 +574,30 @@ int main()
 
             ImGui::Begin("Settings");
 
+            ImGui::Text("Frame time: %.2f ms", 1000.0f * delta_time);
             ImGui::Checkbox("Draw wireframe", &flags.draw_wireframe);
+            if (flags.draw_wireframe)
+                ImGui::SliderFloat("Wireframe width", &flags.wireframe_width, 0.5f, 4.0f);
             ImGui::Checkbox("Show log console", &flags.show_log_console);
+            ImGui::Checkbox("Smooth seams", &flags.smooth_seams);
+            ImGui::Checkbox("Cull back faces", &flags.cull_backfaces);
+            if (!mesh_clusters.empty())
+                ImGui::Text("Visible clusters: %zu / %zu", mesh_clusters.get_visible_count(), mesh_clusters.size());
+            ImGui::Checkbox("Levels of detail", &flags.use_lods);
+            ImGui::SliderFloat("LOD pixel error", &flags.lod_pixel_error, 0.25f, 8.0f);
+            if (!mesh_lods.empty())
+                ImGui::Text("Level of detail: %zu / %zu, %u triangles", drawn_lod, mesh_lods.size() - 1,
+                            mesh_lods.get_level(drawn_lod).range.count / 3);
+            if (ImGui::Button("Undo seam segment") && select_seam_0)
+                select_seam_0->undo();
+            ImGui::Checkbox("Lasso selection", &flags.lasso_selection);
+            ImGui::Checkbox("Select through the mesh", &flags.select_see_through);
+            ImGui::Text("Selected: %zu vertices, %zu faces", select_region.get_num_selected(), selected_faces.count());
+            if (ImGui::Button("Clear selection"))
+            {
+                select_region.clear();
+                selected_faces.reset(selected_faces.size());
+            }
 
             // int currentItem = static_cast<int>(flags.draw_mode);
             // if (ImGui::Combo("Interaction Mode", &currentItem, InteractionModeItems,
@@ -251,6 +608,23 @@ int main()
 
             status_bar.draw();
 
+            if (region_points.size() > 1)
+            {
+                auto draw_list = ImGui::GetForegroundDrawList();
+                auto region_color = IM_COL32(25, 100, 230, 255);
+                if (flags.lasso_selection)
+                {
+                    std::vector<ImVec2> points;
+                    for (const auto &point : region_points)
+                        points.emplace_back(point.x, point.y);
+                    draw_list->AddPolyline(points.data(), static_cast<int>(points.size()), region_color,
+                                           ImDrawFlags_Closed, 1.5f);
+                }
+                else
+                    draw_list->AddRect(ImVec2(region_points[0].x, region_points[0].y),
+                                       ImVec2(region_points[1].x, region_points[1].y), region_color);
+            }
+
             if (flags.show_log_console)
                 logger.draw();
 
@@ -260,31 +634,69 @@ int main()
             glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            // draw the mesh
-            if (flags.draw_wireframe)
+            // draw the mesh, as much of it as is uploaded while loading, then the coarsest level of detail that looks
+            // the same, at full resolution only its clusters in view
+            if (gl_mesh)
             {
-                basic_shader.use();
-                basic_shader.set_MVP(model, view, projection);
-                basic_shader.set_uniform("color", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
-                gl_mesh.draw(MyGL::Mesh::DrawMode::WIREFRAME);
+                drawn_lod = 0;
+                if (flags.use_lods && !mesh_lods.empty())
+                    drawn_lod =
+                        mesh_lods.select(model, view, projection, static_cast<float>(height), flags.lod_pixel_error);
+
+                std::span<const MyGL::Mesh::IndexRange> visible_ranges;
+                if (drawn_lod > 0)
+                    visible_ranges = std::span(&mesh_lods.get_level(drawn_lod).range, 1);
+                else if (!mesh_clusters.empty())
+                    visible_ranges = mesh_clusters.cull(model, view, projection, flags.cull_backfaces);
+                auto draw_mesh = [&](MyGL::Mesh::DrawMode mode) {
+                    if (drawn_lod == 0 && mesh_clusters.empty())
+                        gl_mesh->draw(mode);
+                    else
+                        gl_mesh->draw(mode, visible_ranges);
+                };
+
+                // the position transform decodes quantized positions, octahedral normals are decoded by the shader
+                const auto &shader = flags.draw_wireframe ? phong_wireframe_shader : phong_shader;
+                shader->use();
+                shader->set_model(model * gl_mesh->get_position_transform());
+                shader->set_uniform("octahedral_normals", gl_mesh->get_vertex_format() != MyGL::VertexFormat::FLOAT);
+                shader->set_uniform("color", glm::vec4(1.0f, 0.5f, 0.2f, 1.0f));
+                shader->set_uniform("light_pos", glm::vec3(2.2f, 1.0f, 2.0f));
+                shader->set_uniform("light_color", glm::vec3(1.0f, 1.0f, 1.0f));
+                shader->set_uniform("view_pos", camera.get_position());
+                if (flags.draw_wireframe)
+                {
+                    gl_mesh->set_line_width(flags.wireframe_width);
+                    shader->set_uniform("wireframe_color", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+                    shader->set_uniform("line_width", gl_mesh->get_line_width());
+                    shader->set_uniform("viewport_size", glm::vec2(width, height));
+                    draw_mesh(MyGL::Mesh::DrawMode::SHADED_WIREFRAME);
+                }
+                else
+                    draw_mesh(MyGL::Mesh::DrawMode::FILL);
             }
 
-            phong_shader.use();
-            phong_shader.set_MVP(model, view, projection);
-            phong_shader.set_uniform("color", glm::vec4(1.0f, 0.5f, 0.2f, 1.0f));
-            phong_shader.set_uniform("light_pos", glm::vec3(2.2f, 1.0f, 2.0f));
-            phong_shader.set_uniform("light_color", glm::vec3(1.0f, 1.0f, 1.0f));
-            phong_shader.set_uniform("view_pos", camera.get_position());
-            gl_mesh.draw();
-
-            pick_vertex.highlight_hovered_vertex(gl_mesh, {model, view, projection});
-
-            select_seam_0.draw({model, view, projection});
+            if (gl_mesh)
+                pick_vertex.highlight_hovered_vertex(model);
+            if (select_seam_0)
+            {
+                select_region.highlight_selected_vertices(model);
+                select_seam_0->draw(model);
+            }
 
             // render imgui and swap buffers
             ImGui::Render();
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
             window.swap_buffers();
+
+            if (is_first_frame)
+            {
+                std::chrono::duration<double, std::milli> startup_time = std::chrono::steady_clock::now() - start_time;
+                logger.log("First frame after {:.0f} ms, {} shader programs compiled, {} loaded from binaries",
+                           startup_time.count(), MyGL::ShaderLibrary::get_num_compiled(),
+                           MyGL::ShaderLibrary::get_num_loaded());
+                is_first_frame = false;
+            }
         }
 
         return 0;